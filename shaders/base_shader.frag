@@ -23,12 +23,18 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	vec3 directionalLight;
 	PointLight pointLights[10];
 	int numLights;
+	int cutEnabled;
+	float cutLevel;
 } ubo;
 
 layout(set = 0, binding = 2) uniform sampler2D texSampler[];
 
 // MATRIX MULTIPLICATION ORDER MATTERS
 void main() {
+	// cut view, y points down: everything above the cut level is gone, the chunk caps close the cut
+	if (ubo.cutEnabled == 1 && fragPosWorld.y < ubo.cutLevel - 0.001)
+		discard;
+
 	vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
 	vec3 specularLight = vec3(0.0);
 	vec3 surfaceNormal = normalize(fragNormalWorld);
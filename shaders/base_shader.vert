@@ -25,6 +25,8 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	vec3 directionalLight;
 	PointLight pointLights[10];
 	int numLights;
+	int cutEnabled;
+	float cutLevel;
 } ubo;
 
 layout(push_constant) uniform Push {
@@ -0,0 +1,110 @@
+#version 450
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+layout(location = 4) out int fragTexId;
+
+struct PointLight {
+	vec4 position; //ignote w
+	vec4 color; // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	mat4 inverseViewMatrix;
+	vec4 ambientLightColor;
+	vec3 directionalLight;
+	PointLight pointLights[10];
+	int numLights;
+	int cutEnabled;
+	float cutLevel;
+} ubo;
+
+// packed face records, see EveModel::ChunkFace
+layout(set = 1, binding = 0) readonly buffer FaceBuffer {
+	uvec2 faces[];
+} faceBuffer;
+
+layout(push_constant) uniform Push {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+} push;
+
+// chunk neighbor order: top, down, left, right, near, far
+const int SIDE_AXIS[6] = int[](1, 1, 0, 0, 2, 2);
+
+const vec3 NORMALS[6] = vec3[](
+	vec3(0.0, -1.0, 0.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(-1.0, 0.0, 0.0),
+	vec3(1.0, 0.0, 0.0),
+	vec3(0.0, 0.0, -1.0),
+	vec3(0.0, 0.0, 1.0)
+);
+
+// the canonical quad of Chunk::createFace rotated on each side (keeps the same winding)
+const vec3 CORNERS[24] = vec3[](
+	vec3(-1, 0, -1), vec3(1, 0, 1), vec3(-1, 0, 1), vec3(1, 0, -1),
+	vec3(1, 0, -1), vec3(-1, 0, 1), vec3(1, 0, 1), vec3(-1, 0, -1),
+	vec3(0, 1, -1), vec3(0, -1, 1), vec3(0, 1, 1), vec3(0, -1, -1),
+	vec3(0, -1, -1), vec3(0, 1, 1), vec3(0, -1, 1), vec3(0, 1, -1),
+	vec3(-1, 1, 0), vec3(1, -1, 0), vec3(-1, -1, 0), vec3(1, 1, 0),
+	vec3(-1, -1, 0), vec3(1, 1, 0), vec3(-1, 1, 0), vec3(1, -1, 0)
+);
+const vec2 UVS[4] = vec2[](vec2(1, 0), vec2(0, 1), vec2(1, 1), vec2(0, 0));
+// world axes the uv of each side run along, used to tile the texture over merged faces
+const ivec2 UV_AXES[6] = ivec2[](ivec2(0, 2), ivec2(0, 2), ivec2(1, 2), ivec2(1, 2), ivec2(0, 1), ivec2(0, 1));
+
+const int QUAD_INDICES[6] = int[](0, 1, 2, 1, 0, 3);
+// split along the 2-3 diagonal when it's the brightest one
+const int FLIPPED_QUAD_INDICES[6] = int[](2, 0, 3, 3, 1, 2);
+
+// debug colors of the marked faces, one per quad corner
+const vec3 MARK[4] = vec3[](
+	vec3(1.0, 0.0, 0.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 0.0, 1.0),
+	vec3(0.0, 0.0, 0.0)
+);
+
+// MATRIX MULTIPLICATION ORDER MATTERS
+void main() {
+	uvec2 face = faceBuffer.faces[gl_VertexIndex / 6];
+	uint low = face.x;
+	uint high = face.y;
+
+	uint ao0 = high & 3u;
+	uint ao1 = (high >> 2) & 3u;
+	uint ao2 = (high >> 4) & 3u;
+	uint ao3 = (high >> 6) & 3u;
+	int corner = ao0 + ao1 < ao2 + ao3 ? FLIPPED_QUAD_INDICES[gl_VertexIndex % 6] : QUAD_INDICES[gl_VertexIndex % 6];
+
+	vec3 cell = vec3(low & 31u, (low >> 5) & 31u, (low >> 10) & 31u);
+	float width = float(((low >> 15) & 15u) + 1u);
+	float height = float(((low >> 19) & 15u) + 1u);
+	int side = int((low >> 23) & 7u);
+	bool marked = ((low >> 26) & 1u) == 1u;
+	float ao = float((high >> (corner * 2)) & 3u) / 3.0;
+
+	int axis = SIDE_AXIS[side];
+	vec3 size = vec3(1.0);
+	size[(axis + 1) % 3] = width;
+	size[(axis + 2) % 3] = height;
+
+	vec3 normal = NORMALS[side];
+	vec3 position = cell + size * 0.5 + normal * 0.5 + CORNERS[side * 4 + corner] * size * 0.5;
+
+	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * positionWorld;
+	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	fragPosWorld = positionWorld.xyz;
+	float lightIntensity = max(dot(fragNormalWorld, normalize(ubo.directionalLight)), 0);
+
+	vec3 color = marked ? MARK[corner] : vec3(1.0);
+	fragColor = lightIntensity * color * mix(0.4, 1.0, ao);
+	fragUv = UVS[corner] * vec2(size[UV_AXES[side].x], size[UV_AXES[side].y]);
+	fragTexId = int((high >> 8) & 0xFFFFu);
+}
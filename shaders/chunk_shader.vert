@@ -0,0 +1,74 @@
+#version 450
+
+// packed chunk vertex, see EveModel::ChunkVertex
+layout(location = 0) in uvec2 packedVertex;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosWorld;
+layout(location = 2) out vec3 fragNormalWorld;
+layout(location = 3) out vec2 fragUv;
+layout(location = 4) out int fragTexId;
+
+struct PointLight {
+	vec4 position; //ignote w
+	vec4 color; // w is intensity
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	mat4 inverseViewMatrix;
+	vec4 ambientLightColor;
+	vec3 directionalLight;
+	PointLight pointLights[10];
+	int numLights;
+	int cutEnabled;
+	float cutLevel;
+} ubo;
+
+layout(push_constant) uniform Push {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+} push;
+
+// chunk neighbor order: top, down, left, right, near, far
+const vec3 NORMALS[6] = vec3[](
+	vec3(0.0, -1.0, 0.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(-1.0, 0.0, 0.0),
+	vec3(1.0, 0.0, 0.0),
+	vec3(0.0, 0.0, -1.0),
+	vec3(0.0, 0.0, 1.0)
+);
+
+// debug colors of the marked faces, one per quad corner
+const vec3 MARK[4] = vec3[](
+	vec3(1.0, 0.0, 0.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 0.0, 1.0),
+	vec3(0.0, 0.0, 0.0)
+);
+
+// MATRIX MULTIPLICATION ORDER MATTERS
+void main() {
+	uint low = packedVertex.x;
+	uint high = packedVertex.y;
+
+	vec3 position = vec3(low & 63u, (low >> 6) & 63u, (low >> 12) & 63u);
+	vec3 normal = NORMALS[(low >> 18) & 7u];
+	float ao = float((low >> 21) & 3u) / 3.0;
+	bool marked = ((low >> 23) & 1u) == 1u;
+	vec2 uv = vec2((low >> 24) & 63u, high & 63u);
+	uint corner = (low >> 30) & 3u;
+
+	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * positionWorld;
+	fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	fragPosWorld = positionWorld.xyz;
+	float lightIntensity = max(dot(fragNormalWorld, normalize(ubo.directionalLight)), 0);
+
+	vec3 color = marked ? MARK[corner] : vec3(1.0);
+	fragColor = lightIntensity * color * mix(0.4, 1.0, ao);
+	fragUv = uv;
+	fragTexId = int((high >> 6) & 0xFFFFu);
+}
@@ -0,0 +1,438 @@
+/*
+* Headless meshing benchmark, no window, vulkan device nor physics system.
+* Every pattern is noised into real chunk octrees (the neighbors chunks included, they give the halo) and each chunk
+* is meshed by Chunk::mesh in every meshing mode, like a meshing job between beginRemesh and finishRemesh:
+* halo snapshot, octree or greedy meshing, collider shapes, cut caps (when a layer is set), translucent faces and side grouping.
+* The output sizes and allocations are read from what the meshers really built.
+*
+* usage: EveMeshBench [output.json] [iterations]
+* The results are written as json so two runs can be diffed.
+*/
+
+#include "../engine/game/eve_chunk.hpp"
+#include "../engine/utils/eve_enums.hpp"
+#include "../libs/PerlinNoise/PerlinNoise.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// every allocation of the process is counted (jolt's included), the meshing loop reads the difference
+static std::atomic<size_t> allocationCount{0};
+
+void *operator new(size_t size) {
+	allocationCount++;
+	if (void *ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+static JPH::AllocateFunction joltAllocate = nullptr;
+static JPH::AlignedAllocateFunction joltAlignedAllocate = nullptr;
+
+namespace eve {
+	static constexpr uint16_t AIR = 0;
+	static constexpr uint16_t STONE = 1;
+	static constexpr uint16_t WATER = 3;
+
+	// voxel id at a world cell (y points down, like the terrain)
+	using Pattern = std::function<uint16_t(int x, int y, int z)>;
+
+	struct BenchPattern {
+		std::string name;
+		Pattern sample;
+	};
+
+	struct BenchMode {
+		std::string name;
+		ChunkMeshingSettings settings;
+		bool singleSection; // one dirty section per remesh (a voxel edit), the whole chunk otherwise
+	};
+
+	struct BenchResult {
+		size_t chunks = 0;
+		double nsPerChunk = 0;
+		size_t allocations = 0;
+		// outputs of the last iteration, summed over the chunks
+		size_t faces = 0;
+		size_t meshBytes = 0;
+		size_t capBytes = 0; // 0 without a cut layer in the settings
+		size_t translucentFaces = 0;
+		size_t colliderShapes = 0;
+		size_t objects = 0;
+	};
+
+	static std::vector<BenchPattern> createPatterns(siv::PerlinNoise &perlin) {
+		// same heights as EveTerrain with its default y range
+		const float minHeight = 48.f;
+		const float maxHeight = -48.f;
+		auto terrainHeight = [&perlin, minHeight, maxHeight](int x, int z) {
+			float noise = perlin.octave2D_01((x + .5f) * 0.01, (z + .5f) * 0.01, 4);
+			return std::lerp(minHeight, maxHeight, noise);
+		};
+
+		return {
+			{"flat", [](int, int y, int) { return y >= 4 ? STONE : AIR; }},
+			// worst case, every face is exposed and nothing merges
+			{"checkerboard", [](int x, int y, int z) { return (x + y + z) & 1 ? STONE : AIR; }},
+			{"noise", [terrainHeight](int x, int y, int z) { return terrainHeight(x, z) > y + .5f ? AIR : STONE; }},
+			{"caves", [terrainHeight, &perlin](int x, int y, int z) {
+				if (terrainHeight(x, z) > y + .5f)
+					return AIR;
+				return perlin.octave3D_01(x * 0.05, y * 0.05, z * 0.05, 3) > .6 ? AIR : STONE;
+			}},
+			// the noise with its valleys flooded, for the translucent pass
+			{"lakes", [terrainHeight](int x, int y, int z) {
+				if (terrainHeight(x, z) <= y + .5f)
+					return STONE;
+				return y > 0 ? WATER : AIR;
+			}}
+		};
+	}
+
+	// the octant and its children from the pattern, merged back like Chunk::setVoxel does
+	static void noiseOctant(Octant *octant, const Pattern &pattern, const std::vector<EveVoxel *> &voxelMap) {
+		if (octant->isLeaf) {
+			glm::ivec3 cell = glm::ivec3(glm::floor(octant->position));
+			octant->voxel = voxelMap[pattern(cell.x, cell.y, cell.z)];
+			return;
+		}
+
+		octant->voxel = nullptr;
+		int childWidth = octant->width / 2;
+		for (int i = 0; i < 8; i++) {
+			octant->octants[i] = new Octant(octant->position + getOctreeOffset(i) * float(childWidth) / 2.f, childWidth, octant->container, octant);
+			octant->octants[i]->si = i;
+			noiseOctant(octant->octants[i], pattern, voxelMap);
+		}
+
+		EveVoxel *sample = octant->octants[0]->voxel;
+		octant->isAllSame = true;
+		for (Octant *child : octant->octants)
+			if (!(child->isLeaf || child->isAllSame) || child->voxel != sample)
+				octant->isAllSame = false;
+		if (octant->isAllSame)
+			octant->voxel = sample;
+	}
+
+	static void deleteOctant(Octant *octant) {
+		if (!octant)
+			return;
+		for (Octant *child : octant->octants)
+			deleteOctant(child);
+		delete octant;
+	}
+
+	// the chunk grid the terrain generates by default, linked to their neighbors like EveTerrain::init
+	static std::vector<Chunk *> createChunks(const Pattern &pattern, const std::vector<EveVoxel *> &voxelMap) {
+		std::map<std::tuple<int, int, int>, Chunk *> generated;
+		std::vector<Chunk *> chunks;
+		for (int x = -2; x <= 2; x++) {
+			for (int y = -1; y <= 1; y++) {
+				for (int z = -2; z <= 2; z++) {
+					glm::ivec3 chunkPos = glm::ivec3(x, y, z) * CHUNK_SIZE;
+					Octant *root = new Octant(chunkPos, CHUNK_SIZE, nullptr, nullptr);
+					Chunk *chunk = new Chunk(root, chunkPos, nullptr);
+					root->container = chunk;
+					noiseOctant(root, pattern, voxelMap);
+
+					generated.emplace(std::make_tuple(x, y, z), chunk);
+					chunks.push_back(chunk);
+				}
+			}
+		}
+
+		// chunk neighbor order: top, down, left, right, near, far
+		static constexpr int directions[6][3] = {{0, -1, 0}, {0, 1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 0, 1}};
+		for (auto &[key, chunk] : generated) {
+			auto [x, y, z] = key;
+			for (int side = 0; side < 6; side++) {
+				auto neighbor = generated.find(std::make_tuple(x + directions[side][0], y + directions[side][1], z + directions[side][2]));
+				if (neighbor != generated.end())
+					chunk->neighbors[side] = neighbor->second;
+			}
+		}
+		return chunks;
+	}
+
+	static void destroyChunks(std::vector<Chunk *> &chunks) {
+		for (Chunk *chunk : chunks) {
+			deleteOctant(chunk->root);
+			delete chunk;
+		}
+		chunks.clear();
+	}
+
+	static size_t getBuilderBytes(const EveModel::Builder &builder) {
+		return builder.vertices.size() * sizeof(EveModel::Vertex)
+			+ builder.chunkVertices.size() * sizeof(EveModel::ChunkVertex)
+			+ builder.faces.size() * sizeof(uint64_t)
+			+ builder.indices.size() * sizeof(uint32_t);
+	}
+
+	// what the last mesh of the chunk left for the terrain to upload
+	static void addOutputs(BenchResult &result, Chunk &chunk, EveTerrainMeshingMode meshingMode, uint8_t sectionMask) {
+		// the octant mode only makes cube objects, the builders still hold the other modes outputs
+		if (meshingMode == MESHING_OCTANT) {
+			result.objects += chunk.chunkObjectMap.size();
+			return;
+		}
+
+		for (int i = 0; i < Chunk::SECTION_COUNT; i++) {
+			if (!(sectionMask & (1 << i)))
+				continue;
+			const EveModel::Builder &builder = chunk.sections[i].builder;
+			result.faces += builder.faces.size() + builder.chunkVertices.size() / 4;
+			result.meshBytes += getBuilderBytes(builder);
+			result.colliderShapes += chunk.sections[i].shapeSettings.mSubShapes.size();
+		}
+		result.capBytes += getBuilderBytes(chunk.capBuilder);
+		result.translucentFaces += chunk.translucentQuads.size();
+	}
+
+	static BenchResult runMode(const BenchMode &mode, std::vector<Chunk *> &chunks, int iterations) {
+		BenchResult result;
+		size_t chunkCount = chunks.size();
+
+		// a voxel edit remeshes one section, they take turns so every section is measured
+		auto getSectionMask = [&mode](size_t chunk, int iteration) {
+			return mode.singleSection ? uint8_t(1 << ((chunk + iteration) % Chunk::SECTION_COUNT)) : Chunk::ALL_SECTIONS;
+		};
+
+		// one halo per worker in the engine too
+		ChunkHalo halo;
+		auto meshChunk = [&](size_t chunk, uint8_t sectionMask) {
+			chunks[chunk]->snapshotHalo(halo);
+			chunks[chunk]->mesh(sectionMask, halo, mode.settings);
+		};
+
+		// warm up, the first chunks grow the thread local buffers
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			meshChunk(chunk, Chunk::ALL_SECTIONS);
+
+		size_t allocationsBefore = allocationCount;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+				meshChunk(chunk, getSectionMask(chunk, i));
+		double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+		result.allocations = allocationCount - allocationsBefore;
+
+		// the outputs of a whole chunk mesh, or of the sections the last iteration meshed
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			addOutputs(result, *chunks[chunk], mode.settings.meshingMode, getSectionMask(chunk, iterations - 1));
+
+		result.chunks = chunkCount;
+		result.nsPerChunk = elapsedNs / (double(chunkCount) * iterations);
+		return result;
+	}
+
+	// side, then the min and max corner of a face quad (chunk corner space)
+	using FaceBounds = std::array<int, 7>;
+
+	static FaceBounds getFaceBounds(int side, const glm::vec3 (&corners)[4]) {
+		glm::vec3 min = corners[0], max = corners[0];
+		for (const glm::vec3 &corner : corners) {
+			min = glm::min(min, corner);
+			max = glm::max(max, corner);
+		}
+		glm::ivec3 iMin = glm::ivec3(glm::round(min)), iMax = glm::ivec3(glm::round(max));
+		return {side, iMin.x, iMin.y, iMin.z, iMax.x, iMax.y, iMax.z};
+	}
+
+	// the face records expanded like shaders/chunk_face_shader.vert does
+	static void addRecordBounds(const std::vector<uint64_t> &faces, std::vector<FaceBounds> &bounds, size_t &wideFaces) {
+		for (uint64_t face : faces) {
+			uint32_t low = uint32_t(face);
+			glm::vec3 cell(low & 31u, (low >> 5) & 31u, (low >> 10) & 31u);
+			int width = int((low >> 15) & 15u) + 1;
+			int height = int((low >> 19) & 15u) + 1;
+			int side = int((low >> 23) & 7u);
+			if (width > 1 || height > 1)
+				wideFaces++;
+
+			int axis = EveGreedyMesher::getSideAxis(side);
+			glm::vec3 size(1.f);
+			size[(axis + 1) % 3] = float(width);
+			size[(axis + 2) % 3] = float(height);
+			glm::vec3 normal(FACE_NORMALS[side][0], FACE_NORMALS[side][1], FACE_NORMALS[side][2]);
+
+			glm::vec3 corners[4];
+			for (int i = 0; i < 4; i++) {
+				glm::vec3 corner(FACE_CORNERS[side][i][0], FACE_CORNERS[side][i][1], FACE_CORNERS[side][i][2]);
+				corners[i] = cell + size * .5f + normal * .5f + corner * size * .5f;
+			}
+			bounds.push_back(getFaceBounds(side, corners));
+		}
+	}
+
+	// the packed vertices, 4 per face in the order createFace writes them
+	static void addVertexBounds(const std::vector<EveModel::ChunkVertex> &vertices, std::vector<FaceBounds> &bounds) {
+		for (size_t first = 0; first + 4 <= vertices.size(); first += 4) {
+			glm::vec3 corners[4];
+			for (int i = 0; i < 4; i++) {
+				uint32_t low = vertices[first + i].low;
+				corners[i] = glm::vec3(low & 63u, (low >> 6) & 63u, (low >> 12) & 63u);
+			}
+			bounds.push_back(getFaceBounds(vertices[first].getNormal(), corners));
+		}
+	}
+
+	/*
+	* The octree mesher must put a face at the same place whether it writes face records or vertices. Wide octants
+	* are the catch: a record is one cell deep, so their positive sides have to start at the last layer of the octant.
+	* Checked on blocks of 4 cells (one uniform octant each, every side exposed) before anything is timed.
+	*/
+	static bool checkFaceRecords(const std::vector<EveVoxel *> &voxelMap) {
+		Pattern blocks = [](int x, int y, int z) { return (x & 7) < 4 && (y & 7) < 4 && (z & 7) < 4 ? STONE : AIR; };
+		std::vector<Chunk *> chunks = createChunks(blocks, voxelMap);
+
+		ChunkMeshingSettings settings;
+		settings.meshingMode = MESHING_CHUNK;
+		settings.colliders = false;
+		settings.voxelMap = &voxelMap;
+
+		ChunkHalo halo;
+		size_t wideFaces = 0;
+		bool matching = true;
+		for (Chunk *chunk : chunks) {
+			std::vector<FaceBounds> vertexBounds, recordBounds;
+			chunk->snapshotHalo(halo);
+
+			settings.renderMode = CHUNK_RENDER_VERTICES;
+			chunk->mesh(Chunk::ALL_SECTIONS, halo, settings);
+			for (const Chunk::ChunkSection &section : chunk->sections)
+				addVertexBounds(section.builder.chunkVertices, vertexBounds);
+
+			settings.renderMode = CHUNK_RENDER_FACES;
+			chunk->mesh(Chunk::ALL_SECTIONS, halo, settings);
+			for (const Chunk::ChunkSection &section : chunk->sections)
+				addRecordBounds(section.builder.faces, recordBounds, wideFaces);
+
+			std::sort(vertexBounds.begin(), vertexBounds.end());
+			std::sort(recordBounds.begin(), recordBounds.end());
+			if (vertexBounds != recordBounds) {
+				std::cerr << "face records and vertices disagree in the chunk at " << glm::to_string(chunk->position) << std::endl;
+				matching = false;
+			}
+		}
+		destroyChunks(chunks);
+
+		if (wideFaces == 0) {
+			std::cerr << "no wide octant face got checked" << std::endl;
+			return false;
+		}
+		return matching;
+	}
+
+	static void writeResult(std::ostream &out, const BenchMode &mode, const BenchResult &result, int iterations) {
+		double chunks = double(result.chunks);
+		out << "\t\t\t\t{\"mode\": \"" << mode.name << "\""
+			<< ", \"meshingMode\": " << mode.settings.meshingMode
+			<< ", \"renderMode\": " << mode.settings.renderMode
+			<< ", \"singleSection\": " << (mode.singleSection ? "true" : "false")
+			<< ", \"chunks\": " << result.chunks
+			<< ", \"nsPerChunk\": " << result.nsPerChunk
+			<< ", \"facesPerChunk\": " << result.faces / chunks
+			<< ", \"meshBytesPerChunk\": " << result.meshBytes / chunks
+			<< ", \"capBytesPerChunk\": " << result.capBytes / chunks
+			<< ", \"translucentFacesPerChunk\": " << result.translucentFaces / chunks
+			<< ", \"colliderShapesPerChunk\": " << result.colliderShapes / chunks
+			<< ", \"objectsPerChunk\": " << result.objects / chunks
+			<< ", \"allocationsPerChunk\": " << result.allocations / (chunks * iterations)
+			<< "}";
+	}
+}
+
+int main(int argc, char **argv) {
+	using namespace eve;
+
+	std::string outputPath = argc > 1 ? argv[1] : "mesh_bench.json";
+	int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+	// the collider shapes are jolt objects, its allocations are counted with the others
+	JPH::RegisterDefaultAllocator();
+	joltAllocate = JPH::Allocate;
+	joltAlignedAllocate = JPH::AlignedAllocate;
+	JPH::Allocate = [](size_t size) { allocationCount++; return joltAllocate(size); };
+	JPH::AlignedAllocate = [](size_t size, size_t alignment) { allocationCount++; return joltAlignedAllocate(size, alignment); };
+
+	// same ids as EveTerrain::voxelMap
+	std::vector<EveVoxel *> voxelMap = {
+		new EveVoxel(0, "air", false),
+		new EveVoxel(1, "stone", true),
+		new EveVoxel(2, "dirt", true),
+		new EveVoxel(3, "water", false, true)
+	};
+
+	if (!checkFaceRecords(voxelMap))
+		return EXIT_FAILURE;
+
+	// fixed seed, two runs mesh the same chunks
+	siv::PerlinNoise perlin{123456u};
+	std::vector<BenchPattern> patterns = createPatterns(perlin);
+
+	// the meshers build their octant boxes with COLLIDER_BOXES, the other collider modes don't follow the meshing
+	auto settings = [&voxelMap](EveTerrainMeshingMode meshingMode, EveChunkRenderMode renderMode) {
+		ChunkMeshingSettings settings;
+		settings.meshingMode = meshingMode;
+		settings.renderMode = renderMode;
+		settings.colliderMode = COLLIDER_BOXES;
+		settings.voxelMap = &voxelMap;
+		return settings;
+	};
+	std::vector<BenchMode> modes = {
+		{"octant", settings(MESHING_OCTANT, CHUNK_RENDER_VERTICES), false},
+		{"chunk", settings(MESHING_CHUNK, CHUNK_RENDER_VERTICES), false},
+		{"chunk_faces", settings(MESHING_CHUNK, CHUNK_RENDER_FACES), false},
+		{"greedy", settings(MESHING_GREEDY, CHUNK_RENDER_VERTICES), false},
+		{"greedy_faces", settings(MESHING_GREEDY, CHUNK_RENDER_FACES), false},
+		{"greedy_section", settings(MESHING_GREEDY, CHUNK_RENDER_VERTICES), true}
+	};
+
+	std::ofstream file(outputPath);
+	if (!file) {
+		std::cerr << "can't write " << outputPath << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	file << "{\n\t\"iterations\": " << iterations << ",\n\t\"patterns\": [\n";
+	for (size_t p = 0; p < patterns.size(); p++) {
+		std::vector<Chunk *> chunks = createChunks(patterns[p].sample, voxelMap);
+
+		file << "\t\t{\n\t\t\t\"pattern\": \"" << patterns[p].name << "\",\n\t\t\t\"modes\": [\n";
+		for (size_t m = 0; m < modes.size(); m++) {
+			BenchResult result = runMode(modes[m], chunks, iterations);
+			writeResult(file, modes[m], result, iterations);
+			file << (m + 1 < modes.size() ? ",\n" : "\n");
+
+			std::cout << patterns[p].name << " " << modes[m].name << ": " << result.nsPerChunk / 1000 << " us/chunk, "
+				<< double(result.faces) / result.chunks << " faces/chunk, "
+				<< double(result.allocations) / (double(result.chunks) * iterations) << " allocations/chunk" << std::endl;
+		}
+		file << "\t\t\t]\n\t\t}" << (p + 1 < patterns.size() ? ",\n" : "\n");
+
+		destroyChunks(chunks);
+	}
+	file << "\t]\n}\n";
+
+	for (EveVoxel *voxel : voxelMap)
+		delete voxel;
+
+	std::cout << "results written to " << outputPath << std::endl;
+	return EXIT_SUCCESS;
+}
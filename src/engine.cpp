@@ -2,9 +2,11 @@
 #include "engine/device/eve_keyboard.hpp"
 #include "engine/utils/eve_buffer.hpp"
 #include "engine/systems/base_render_system.hpp"
+#include "engine/systems/chunk_face_render_system.hpp"
 #include "engine/systems/point_light_system.hpp"
 #include "engine/systems/imgui_system.hpp"
 #include "engine/game/eve_camera.hpp"
+#include "engine/utils/eve_phase_graph.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -84,6 +86,7 @@ namespace eve
 		}
 
 		BaseRenderSystem simpleRenderSystem{eveDevice, eveRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout(), eveWorld.eveTerrain};
+		ChunkFaceRenderSystem chunkFaceRenderSystem{eveDevice, eveRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
 		PointLightSystem pointLightSystem{eveDevice, eveRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
 		ImGuiSystem imGuiSystem{eveDevice, eveRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
 
@@ -91,32 +94,40 @@ namespace eve
 
 		eveWorld.init();
 
-		while (!eveWindow.shouldClose())
-		{
-			EASY_BLOCK("App Loop");
-			glfwPollEvents();
-
-
-			auto newTime = std::chrono::high_resolution_clock::now();
-			float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
-			currentTime = newTime;
-
-			eveWorld.tick(frameTime);
-
-			if (auto commandBuffer = eveRenderer.beginFrame())
+		/*
+		* Frame phases, joined at the end of every frame:
+		* the world tick syncs the physics transforms, integrates terrain and moves the camera,
+		* then the chunk map bookkeeping (lods, colliders, caps, translucent sort) runs on a worker
+		* while the main thread records the scene. The debug menu edits the terrain settings, it waits for both.
+		*/
+		float frameTime = 0.f;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		auto makeFrameInfo = [&] {
+			int frameIndex = eveRenderer.getFrameIndex();
+			return FrameInfo{
+				frameIndex,
+				frameTime,
+				commandBuffer,
+				eveWorld.camera,
+				globalDescriptorSets[frameIndex],
+				eveWorld.gameObjects,
+				eveWorld.debugMenu,
+				eveWorld.eveTerrain};
+		};
+
+		EvePhaseGraph frameGraph{eveWorld.scheduler};
+
+		auto worldTick = frameGraph.addPhase("world tick", [&] { eveWorld.tick(frameTime); });
+		// doesn't touch what's drawn this frame (the translucent order is picked up by the next tick)
+		auto terrainUpdate = frameGraph.addPhase("terrain update", [&] { eveWorld.updateTerrain(); }, LANE_FRAME, {worldTick});
+		auto render = frameGraph.addPhase("render", [&] {
+			commandBuffer = eveRenderer.beginFrame();
+			if (commandBuffer)
 			{
 				EASY_BLOCK("Command Buffer");
 
-				int frameIndex = eveRenderer.getFrameIndex();
-				FrameInfo frameInfo{
-					frameIndex,
-					frameTime,
-					commandBuffer,
-					eveWorld.camera,
-					globalDescriptorSets[frameIndex],
-					eveWorld.gameObjects,
-					eveWorld.debugMenu,
-					eveWorld.eveTerrain};
+				FrameInfo frameInfo = makeFrameInfo();
+				int frameIndex = frameInfo.frameIndex;
 
 				// update
 				EASY_BLOCK("Update");
@@ -124,6 +135,8 @@ namespace eve
 				ubo.projectionMatrix = eveWorld.camera.getProjection();
 				ubo.viewMatrix = eveWorld.camera.getView();
 				ubo.inverseViewMatrix = eveWorld.camera.getInverseView();
+				ubo.cutEnabled = eveWorld.eveTerrain.cutEnabled;
+				ubo.cutLevel = float(eveWorld.eveTerrain.playerCurrentLevel);
 				simpleRenderSystem.update(frameInfo, ubo);
 				pointLightSystem.update(frameInfo, ubo);
 				uboBuffers[frameIndex]->writeToBuffer(&ubo);
@@ -133,7 +146,6 @@ namespace eve
 
 				// render
 				EASY_BLOCK("Render");
-				//boost::lock_guard<boost::mutex> lock(eveTerrain.mutex);
 				eveRenderer.beginSwapChainRenderPass(commandBuffer);
 
 				// order here matters
@@ -141,19 +153,47 @@ namespace eve
 				simpleRenderSystem.renderGameObjects(frameInfo);
 				EASY_END_BLOCK;
 
+				EASY_BLOCK("Chunk face render system");
+				chunkFaceRenderSystem.render(frameInfo);
+				EASY_END_BLOCK;
+
 				EASY_BLOCK("Point light system");
 				pointLightSystem.render(frameInfo);
 				EASY_END_BLOCK;
 
-				EASY_BLOCK("IMGUI system");
-				imGuiSystem.render(frameInfo);
+				// translucent chunks last, blended over everything opaque
+				EASY_BLOCK("Translucent chunks");
+				simpleRenderSystem.renderTranslucent(frameInfo);
+				chunkFaceRenderSystem.renderTranslucent(frameInfo);
 				EASY_END_BLOCK;
-				
-				eveRenderer.endSwapChainRenderPass(commandBuffer);
-				eveRenderer.endFrame();
-				//boost::lock_guard<boost::mutex> unlock(eveTerrain.mutex);
+
 				EASY_END_BLOCK;
 			}
+		}, LANE_MAIN, {worldTick});
+		frameGraph.addPhase("debug menu", [&] {
+			if (!commandBuffer)
+				return;
+
+			FrameInfo frameInfo = makeFrameInfo();
+			EASY_BLOCK("IMGUI system");
+			imGuiSystem.render(frameInfo);
+			EASY_END_BLOCK;
+
+			eveRenderer.endSwapChainRenderPass(commandBuffer);
+			eveRenderer.endFrame();
+		}, LANE_MAIN, {terrainUpdate, render});
+
+		while (!eveWindow.shouldClose())
+		{
+			EASY_BLOCK("App Loop");
+			glfwPollEvents();
+
+
+			auto newTime = std::chrono::high_resolution_clock::now();
+			frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
+			currentTime = newTime;
+
+			frameGraph.run();
 			EASY_END_BLOCK;
 		}
 
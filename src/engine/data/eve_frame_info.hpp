@@ -27,6 +27,8 @@ namespace eve {
 		alignas(16) glm::vec3 directionalLight{1.f};
 		alignas(16) PointLight pointLights[MAX_LIGHTS];
 		alignas(4) int numLights;
+		alignas(4) int cutEnabled; // cut view, see EveTerrain::cutEnabled
+		alignas(4) float cutLevel;
 	};
 
 	struct FrameInfo {
@@ -608,6 +608,57 @@ namespace eve
 		endSingleTimeCommands(commandBuffer);
 	}
 
+	PendingUpload EveDevice::copyBufferAsync(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+	{
+		PendingUpload upload{};
+		upload.commandBuffer = beginSingleTimeCommands();
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = size;
+		vkCmdCopyBuffer(upload.commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+		// the frames drawing the buffer are submitted after this on the same queue, no need to wait for the fence
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			upload.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+		vkEndCommandBuffer(upload.commandBuffer);
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device_, &fenceInfo, nullptr, &upload.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &upload.commandBuffer;
+		vkQueueSubmit(graphicsQueue_, 1, &submitInfo, upload.fence);
+
+		return upload;
+	}
+
+	void EveDevice::releaseUpload(PendingUpload &upload)
+	{
+		if (upload.fence == VK_NULL_HANDLE)
+			return;
+
+		vkWaitForFences(device_, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+		vkDestroyFence(device_, upload.fence, nullptr);
+		vkFreeCommandBuffers(device_, commandPool, 1, &upload.commandBuffer);
+		upload = PendingUpload{};
+	}
+
 	void EveDevice::copyBufferToImage(
 		VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
 	{
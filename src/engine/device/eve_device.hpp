@@ -25,6 +25,13 @@ namespace eve
 		bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 	};
 
+	// copy submitted without waiting, poll the fence (see fenceSignaled in eve_task.hpp) before releasing it
+	struct PendingUpload
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+	};
+
 	class EveDevice
 	{
 	public:
@@ -65,6 +72,10 @@ namespace eve
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		// the later submissions of the queue see the copy (barrier), only the staging buffer has to wait for the fence
+		PendingUpload copyBufferAsync(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		// waits for the fence if it isn't signaled yet
+		void releaseUpload(PendingUpload &upload);
 		void copyBufferToImage(
 			VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -1,4 +1,5 @@
 #include "eve_keyboard.hpp"
+#include <imgui.h>
 #include <iostream>
 
 
@@ -17,6 +18,9 @@ namespace eve
 	void EveKeyboardController::mouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
 		if (button == GLFW_MOUSE_BUTTON_1) { // left
 			leftMouseButton = action;
+			// clicks on the debug menu stay there
+			if (leftMouseButton == GLFW_RELEASE && !ImGui::GetIO().WantCaptureMouse)
+				eveWorld->breakVoxel();
 			return;
 		}
 		if (button == GLFW_MOUSE_BUTTON_2) { //right
@@ -1,8 +1,10 @@
 #include "eve_chunk.hpp"
 #include "eve_terrain.hpp"
 
+#include <algorithm>
+
 namespace eve {
-	EveVoxel::EveVoxel(unsigned int i, std::string n, bool v) : id{i}, name{n}, value{v} {}
+	EveVoxel::EveVoxel(unsigned int i, std::string n, bool v, bool t) : id{i}, name{n}, value{v}, translucent{t} {}
 
 	Octant::Octant(glm::vec3 pos, int w, Chunk *containerChunk, Octant *parentOctant) {
 		
@@ -49,7 +51,7 @@ namespace eve {
 			int childWidth = octant->width / 2;
 			for (int i = 0; i < 8; i++) {
 				if (!octant->octants[i])
-					octants[i] = new Octant((octant->position + glm::vec3(terrain->octreeOffsets[i] * childWidth) / 2), childWidth, octant->container, octant);
+					octants[i] = new Octant(octant->position + getOctreeOffset(i) * float(childWidth) / 2.f, childWidth, octant->container, octant);
 				octant->octants[i]->noiseOctant(octant->octants[i]);
 				octant->octants[i]->si = i;
 			}
@@ -69,7 +71,7 @@ namespace eve {
 	glm::vec3 Octant::getChildLocalOffset() {
 		glm::vec3 offset = glm::vec3(0);
 		if (parent) {
-			offset += parent->getChildLocalOffset() + (glm::vec3(container->eveTerrain->octreeOffsets[si]) * (float(width) / 2));
+			offset += parent->getChildLocalOffset() + (getOctreeOffset(si) * (float(width) / 2));
 		}
 		if (!parent) {
 			return glm::vec3(0);
@@ -89,7 +91,7 @@ namespace eve {
 		int childWidth = root->width / 2;
 		for (int i = 0; i < 8; i++) {
 			if (!octant->octants[i])
-				octant->octants[i] = new Octant((octant->position + glm::vec3(eveTerrain->octreeOffsets[i] * childWidth) / 2), childWidth, octant->container, octant);
+				octant->octants[i] = new Octant(octant->position + getOctreeOffset(i) * float(childWidth) / 2.f, childWidth, octant->container, octant);
 			octant->octants[i]->noiseOctant(octant->octants[i]);
 			octant->octants[i]->si = i; // this is just for qol
 		}
@@ -107,13 +109,13 @@ namespace eve {
 
 		EASY_BLOCK("Push Noised Chunk");
 
+		boost::lock_guard<boost::mutex> lock2(eveTerrain->mutex);
 		eveTerrain->noisingProcessing.erase(
 			std::find(eveTerrain->noisingProcessing.begin(),
 			eveTerrain->noisingProcessing.end(),
 			octant->container));
-
-		boost::lock_guard<boost::mutex> lock2(eveTerrain->mutex);
 		eveTerrain->noisingProcessed.push_back(octant->container);
+		setStage(CHUNK_STAGE_NOISED);
 
 		//std::cout << "Finished a chunk noising" << glm::to_string(octant->container->position) << " " << glm::to_string(octant->container->countTracker) << std::endl;
 	}
@@ -124,36 +126,46 @@ namespace eve {
 
 		if (octant) 
 		{
-			if (octant->isAllSame || octant->isLeaf) {
-				if (octant->voxel) {
-					if (octant->voxel->id != 0) {
-						boost::lock_guard<boost::mutex> lock(mutex);
-
-						auto cube = EveGameObject::createGameObject();
-						cube.model = eveTerrain->eveCube;
-						cube.transform.translation = octant->position;
-						cube.transform.scale = (glm::vec3(octant->width)) / 2;
-						chunkObjectMap.emplace(cube.getId(), std::move(cube));
-					}
-				}
-			} else {
-				for (int i = 0; i < 8; i++) {
-					if (octant->octants[i])
-						remesh(octant->octants[i]);
-				}
-			}
+			addCubes(octant, eveTerrain->eveCube);
 
 			if (octant->container->root == octant) {
+				{
+					// the cubes don't come with caps, the terrain asks for the ones of the cut again
+					boost::lock_guard<boost::mutex> chunkLock(mutex);
+					capLayer = -1;
+				}
 				boost::lock_guard<boost::mutex> lock(eveTerrain->mutex);
 				EveTerrain *eveTerrain = octant->container->eveTerrain;
 				eveTerrain->remeshingProcessing.erase(std::find(eveTerrain->remeshingProcessing.begin(), eveTerrain->remeshingProcessing.end(), this));
 				eveTerrain->remeshingProcessed.push_back(this);
+				setStage(CHUNK_STAGE_MESHED);
 				std::string pos = glm::to_string(this->position);
 				std::cout << "Finished chunk id:" << id << " remeshing" << pos << std::endl;
 			}
 		}
 	}
 
+	void Chunk::addCubes(Octant *octant, const std::shared_ptr<EveModel> &cubeModel) {
+		if (!octant)
+			return;
+
+		if (octant->isAllSame || octant->isLeaf) {
+			if (octant->voxel && octant->voxel->isOpaque()) {
+				boost::lock_guard<boost::mutex> lock(mutex);
+
+				auto cube = EveGameObject::createGameObject();
+				cube.model = cubeModel;
+				cube.transform.translation = octant->position;
+				cube.transform.scale = (glm::vec3(octant->width)) / 2;
+				chunkObjectMap.emplace(cube.getId(), std::move(cube));
+			}
+			return;
+		}
+
+		for (int i = 0; i < 8; i++)
+			addCubes(octant->octants[i], cubeModel);
+	}
+
 	EveVoxel *Octant::getFirstFoundVoxel(Octant *octant) {
 		for (int i = 0; i < 7; i++) {
 			if (octant->octants[i]) {
@@ -168,47 +180,57 @@ namespace eve {
 		return nullptr; // warning supress (fixme)
 	}
 
-	Octant *Octant::transposePathingFromContainerInvDir(const OctantSide side) {
+	template <int S>
+	Octant *Octant::transposePathingFromContainerInvDir() {
 		EASY_FUNCTION(profiler::colors::Orange300);
-		std::vector<int> path {};
+		constexpr int direction = OCTANT_SIDES[S].direction;
+
+		// a chunk octree is at most log2(CHUNK_SIZE) levels deep
+		int path[8];
+		int depth = 0;
 		Octant *iterator = this;
 
 		while (iterator->parent) {
-			path.insert(path.begin(), iterator->si);
+			path[depth++] = iterator->si;
 			iterator = iterator->parent;
 		}
 
-		iterator = container->neighbors[side.neighborDirection]->root;
-		for (int index : path) {
-			if (!iterator->octants[index + side.direction]) {
+		iterator = container->neighbors[S]->root;
+		while (depth > 0) {
+			int index = path[--depth] + direction;
+			if (!iterator->octants[index]) {
 				std::cout << "error";
 				return nullptr;
 			}
-			iterator = iterator->octants[index + side.direction];
+			iterator = iterator->octants[index];
 		}
 		return iterator;
 	}
 
-	Octant *Octant::findNeighborFromEdge(const OctantSide side){
+	template <int S>
+	Octant *Octant::findNeighborFromEdge(){
 		EASY_FUNCTION(profiler::colors::Orange600);
+		constexpr int direction = OCTANT_SIDES[S].direction;
+		constexpr int members = sideMemberMask(S);
+
 		if (si == -1 ) {
-			if (container->neighbors[side.neighborDirection]) {
-				return transposePathingFromContainerInvDir(side);
+			if (container->neighbors[S]) {
+				return transposePathingFromContainerInvDir<S>();
 			}
 			else {
 				return nullptr;
 			}
 		}
 
-		if (std::find(std::begin(side.members), std::end(side.members), si) != std::end(side.members)) { // top side
+		if (members & (1 << si)) { // top side
 			if (parent) {
-				Octant *iterator = parent->findNeighborFromEdge(side);
+				Octant *iterator = parent->findNeighborFromEdge<S>();
 				if (iterator) {
 					if (iterator->isAllSame) {
 						return iterator;
 					}
 					else {
-						return iterator->octants[si + side.direction];
+						return iterator->octants[si + direction];
 					}
 				}
 				else {
@@ -216,96 +238,88 @@ namespace eve {
 				}
 			}
 		}
-		else if (std::find(std::begin(side.members), std::end(side.members), si) == std::end(side.members)) { // bot side
-			return parent->octants[si - side.direction];
+		else { // bot side
+			return parent->octants[si - direction];
 		}
 		return nullptr;
 	}
 
-	std::vector<Octant *> Octant::getAllSubOctants(const OctantSide side) {
+	template <int S>
+	void Octant::getAllSubOctants(std::vector<Octant *> &subOctants) {
 		EASY_FUNCTION(profiler::colors::Orange900);
-		std::vector<Octant *> list {};
-		int i = 0;
-		
+
 		if (!isAllSame && !isLeaf) {
-			for (int i : side.members) {
-				std::vector<Octant *> subOcts = octants[i]->getAllSubOctants(side);
-				for (Octant *sub : subOcts) {
-					list.push_back(sub);
-				}
-			}
+			for (int i : OCTANT_SIDES[S].members)
+				octants[i]->getAllSubOctants<S>(subOctants);
 		}
 		else {
-			 list.push_back(this);
+			subOctants.push_back(this);
 		}
-		return list;
 	}
 
-	std::vector<Octant *> Octant::getNeighbors(const OctantSide side) {
+	template <int S>
+	void Octant::getNeighbors(std::vector<Octant *> &neighbors) {
 		EASY_FUNCTION(profiler::colors::Blue200);
-		if (parent) {	
-			if (std::find(std::begin(side.members), std::end(side.members), si) != std::end(side.members)) { // top side of the octant
-				std::vector<Octant *> neighbors;
-				Octant *neighbor = nullptr;
+		constexpr int direction = OCTANT_SIDES[S].direction;
+		constexpr int members = sideMemberMask(S);
+		constexpr int reverse = OctantSides::reverse(S);
 
-				neighbor = findNeighborFromEdge(side);
+		if (parent) {	
+			if (members & (1 << si)) { // top side of the octant
+				Octant *neighbor = findNeighborFromEdge<S>();
 				if (!neighbor) { // top chunk don't have neighbors
-					return std::vector<Octant *> {};
+					return;
 				}
 
 				// smaller than us
 				if (!neighbor->isAllSame) {
-					neighbors = neighbor->getAllSubOctants(OctantSides::reverseSide(side));
+					neighbor->getAllSubOctants<reverse>(neighbors);
 					if (neighbors.size() > 0) {
-						return neighbors;
+						return;
 					}
 				}
 				
 				// same size than us
-				if (neighbor->isAllSame || neighbor->isLeaf) 
-					return std::vector<Octant *> {neighbor};
+				if (neighbor->isAllSame || neighbor->isLeaf) {
+					neighbors.push_back(neighbor);
+					return;
+				}
 				
 				// bigger than us
-				if (parent->octants[si + side.direction]) 
-					return std::vector<Octant *> {parent->octants[si + side.direction]};
-					
+				if (parent->octants[si + direction]) 
+					neighbors.push_back(parent->octants[si + direction]);
 			}
-			else if (std::find(std::begin(side.members), std::end(side.members), si) == std::end(side.members)) { // bot side of the octant
-				std::vector<Octant *> neighbors;
-
-				Octant *neighbor = parent->octants[si - side.direction];
+			else { // bot side of the octant
+				Octant *neighbor = parent->octants[si - direction];
 				
 				// smaller than us
 				if (!neighbor->isAllSame) {
-					neighbors = neighbor->getAllSubOctants(OctantSides::reverseSide(side));
+					neighbor->getAllSubOctants<reverse>(neighbors);
 					if (neighbors.size() > 0) {
-						return neighbors;
+						return;
 					}
 				}
 
 				// same size than us
 				if (neighbor->isAllSame || neighbor->isLeaf) 
-					return std::vector<Octant *> {neighbor};
+					neighbors.push_back(neighbor);
 			}
 		}
-		else if (container->neighbors[side.neighborDirection]) { // when max size
-			std::vector<Octant *> neighbors; 
-			Octant *neighbor = container->neighbors[side.neighborDirection]->root;
+		else if (container->neighbors[S]) { // when max size
+			Octant *neighbor = container->neighbors[S]->root;
 
 			// smaller than us
 			if (!neighbor->isAllSame) {
-				neighbors = neighbor->getAllSubOctants(OctantSides::reverseSide(side));
+				neighbor->getAllSubOctants<reverse>(neighbors);
 				if (neighbors.size() > 0) {
-					return neighbors;
+					return;
 				}
 			}
 
 			//same size than us
 			if (neighbor->isAllSame || neighbor->isLeaf) 
-				return std::vector<Octant *> {neighbor};
+				neighbors.push_back(neighbor);
 		}
-		
-		return std::vector<Octant *> {};
 	}
 
 	int Octant::getChildIndexFromPos(glm::vec3 queryPoint) {
@@ -350,50 +364,91 @@ namespace eve {
 		return this;
 	}
 
-	glm::vec3 rotateV(const OctantSide side, glm::vec3 coord) {
-		if (side.direction == 4) {
-			glm::mat4 rotationMat(1);
-			rotationMat = glm::rotate(rotationMat, glm::radians(0.f), glm::vec3(0.0, 0.0, 1.0));
-			return glm::vec3(rotationMat * glm::vec4(coord, 1.0));
-		} else if (side.direction == -4) {
-			glm::mat4 rotationMat(1);
-			rotationMat = glm::rotate(rotationMat, glm::radians(180.f), glm::vec3(0.0, 0.0, 1.0));
-			return glm::vec3(rotationMat * glm::vec4(coord, 1.0));
-		} else if (side.direction == 2) {
-			glm::mat4 rotationMat(1);
-			rotationMat = glm::rotate(rotationMat, glm::radians(270.f), glm::vec3(0.0, 0.0, 1.0));
-			return glm::vec3(rotationMat * glm::vec4(coord, 1.0));
-		} else if (side.direction == -2) {
-			glm::mat4 rotationMat(1);
-			rotationMat = glm::rotate(rotationMat, glm::radians(90.f), glm::vec3(0.0, 0.0, 1.0));
-			return glm::vec3(rotationMat * glm::vec4(coord, 1.0));
-		} else if (side.direction == 1) {
-			glm::mat4 rotationMat(1);
-			rotationMat = glm::rotate(rotationMat, glm::radians(90.f), glm::vec3(1.0, 0.0, 0.0));
-			return glm::vec3(rotationMat * glm::vec4(coord, 1.0));
-		} else if (side.direction == -1) {
-			glm::mat4 rotationMat(1);
-			rotationMat = glm::rotate(rotationMat, glm::radians(-90.f), glm::vec3(1.0, 0.0, 0.0));
-			return glm::vec3(rotationMat * glm::vec4(coord, 1.0));
-		}
-		return glm::vec3(0);
-	}
-
-	glm::vec3 offsetV(const OctantSide side, glm::vec3 coord, float amount) {
-		if (side.direction == 4) {
-			return glm::vec3(coord.x, coord.y - amount, coord.z);
-		} else if (side.direction == -4) {
-			return glm::vec3(coord.x, coord.y + amount, coord.z);
-		} else if (side.direction == 2) {
-			return glm::vec3(coord.x - amount, coord.y, coord.z);
-		} else if (side.direction == -2) {
-			return glm::vec3(coord.x + amount, coord.y, coord.z);
-		} else if (side.direction == 1) {
-			return glm::vec3(coord.x, coord.y, coord.z - amount);
-		} else if (side.direction == -1) {
-			return glm::vec3(coord.x, coord.y, coord.z + amount);
-		}
-		return glm::vec3(0);
+	Chunk *Chunk::getNeighborChunk(glm::ivec3 direction) {
+		Chunk *chunk = this;
+		for (int axis = 0; axis < 3 && chunk; axis++) {
+			// chunk neighbor order, y is 0/1, x is 2/3 and z is 4/5
+			int negativeSide = axis == 1 ? 0 : axis == 0 ? 2 : 4;
+			if (direction[axis] < 0)
+				chunk = chunk->neighbors[negativeSide];
+			else if (direction[axis] > 0)
+				chunk = chunk->neighbors[negativeSide + 1];
+		}
+		return chunk;
+	}
+
+	uint8_t Chunk::getVisibleSides(glm::vec3 eye) const {
+		// a side faces the eye only when the eye is in front of at least one of its planes
+		glm::vec3 min = glm::vec3(position) - float(CHUNK_SIZE / 2);
+		glm::vec3 max = glm::vec3(position) + float(CHUNK_SIZE / 2);
+		uint8_t sides = 0;
+		for (int side = 0; side < 6; side++) {
+			int axis = EveGreedyMesher::getSideAxis(side);
+			bool visible = EveGreedyMesher::isNegativeSide(side) ? eye[axis] < max[axis] : eye[axis] > min[axis];
+			if (visible)
+				sides |= 1 << side;
+		}
+		return sides;
+	}
+
+	// octant the cell at coord is meshed with at lodWidth, like fillGreedyMesher
+	static Octant *getLodContainerAt(Octant *octant, glm::vec3 coord, int lodWidth) {
+		while (octant && !octant->isLeaf && !octant->isAllSame && octant->width > lodWidth)
+			octant = octant->octants[octant->getChildIndexFromPos(coord)];
+		return octant;
+	}
+
+	void Chunk::snapshotHalo(ChunkHalo &halo) {
+		EASY_FUNCTION(profiler::colors::Orange300);
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					glm::ivec3 direction(dx, dy, dz);
+					if (direction == glm::ivec3(0))
+						continue;
+
+					// our cells facing that neighbor: -1 or CHUNK_SIZE on the offset axes, the whole side on the others
+					glm::ivec3 min, max;
+					for (int axis = 0; axis < 3; axis++) {
+						min[axis] = direction[axis] < 0 ? -1 : direction[axis] > 0 ? CHUNK_SIZE : 0;
+						max[axis] = direction[axis] < 0 ? 0 : direction[axis] > 0 ? CHUNK_SIZE + 1 : CHUNK_SIZE;
+					}
+
+					Chunk *neighbor = getNeighborChunk(direction);
+					if (!neighbor) {
+						for (int z = min.z; z < max.z; z++)
+							for (int y = min.y; y < max.y; y++)
+								for (int x = min.x; x < max.x; x++)
+									halo.set(glm::ivec3(x, y, z), ChunkHalo::UNKNOWN);
+						continue;
+					}
+
+					// the neighbor as it's meshed: cells of a coarse neighbor are its lod cells, so both sides of the border
+					// agree on where the faces are and no crack opens between two lods
+					int lodWidth = 1 << neighbor->lod;
+					Octant *lastOctant = nullptr;
+					uint16_t lastType = ChunkHalo::UNKNOWN;
+					boost::lock_guard<boost::mutex> lock(neighbor->mutex);
+					for (int z = min.z; z < max.z; z++) {
+						for (int y = min.y; y < max.y; y++) {
+							for (int x = min.x; x < max.x; x++) {
+								glm::vec3 coord = root->position + glm::vec3(x, y, z) - float(CHUNK_SIZE / 2) + .5f;
+								Octant *octant = getLodContainerAt(neighbor->root, coord, lodWidth);
+								// a collapsed octant covers a run of halo cells, its type is only worked out once
+								if (octant != lastOctant) {
+									lastOctant = octant;
+									if (!octant || ((octant->isLeaf || octant->isAllSame) && !octant->voxel))
+										lastType = ChunkHalo::UNKNOWN;
+									else
+										lastType = getLodType(octant);
+								}
+								halo.set(glm::ivec3(x, y, z), lastType);
+							}
+						}
+					}
+				}
+			}
+		}
 	}
 
 	Chunk::Chunk(Octant *r, glm::vec3 pos, EveTerrain *terrain): root{r}, position{pos}, eveTerrain{terrain} {
@@ -403,208 +458,919 @@ namespace eve {
 
 	Chunk::~Chunk(){
 		std::cout << "Destroyed chunk" << std::endl;
-		eveTerrain->evePhysx.body_interface->RemoveBody(chunkPhysxObject);
-		eveTerrain->evePhysx.body_interface->DestroyBody(chunkPhysxObject);
+
+		// the waiters will never see their stage, they resume with false instead of staying suspended forever
+		std::vector<StageWaiter> waiters;
+		{
+			boost::lock_guard<boost::mutex> lock(stageMutex);
+			waiters.swap(stageWaiters);
+		}
+		for (StageWaiter &waiter : waiters) {
+			*waiter.reached = false;
+			eveTerrain->eveScheduler.postResume(waiter.handle, waiter.lane);
+		}
+
+		releasePendingMesh();
+		removeSectionBodies(ALL_SECTIONS);
+		destroyVoxelBody();
 	};
 
-	void Chunk::createFace(Octant *octant, std::vector<glm::vec3> colors, const OctantSide side) {
-		/*if (octant->container->position == glm::ivec3(16, 0, -16)) {
-			if (octant->position == glm::vec3(9, -3, -23)) {
-				std::cout << ">>>>>";
+	void Chunk::releasePendingMesh() {
+		for (ChunkSection &section : sections)
+			releasePendingMesh(section);
+	}
+
+	void Chunk::releasePendingMesh(ChunkSection &section) {
+		// only finishRemesh accounts bytes, a chunk meshed without terrain never has any
+		if (section.pendingMeshBytes) {
+			eveTerrain->pendingMeshBytes -= section.pendingMeshBytes;
+			section.pendingMeshBytes = 0;
+		}
+
+		// swap with empty vectors, clear() keeps the capacity around
+		std::vector<EveModel::Vertex>().swap(section.builder.vertices);
+		std::vector<EveModel::ChunkVertex>().swap(section.builder.chunkVertices);
+		std::vector<uint64_t>().swap(section.builder.faces);
+		std::vector<uint32_t>().swap(section.builder.indices);
+	}
+
+	void Chunk::setVoxel(glm::ivec3 cell, EveVoxel *voxel) {
+		EASY_FUNCTION(profiler::colors::Magenta);
+		glm::vec3 coord = root->position + glm::vec3(cell) - float(CHUNK_SIZE / 2) + .5f;
+
+		Octant *octant = root;
+		while (!octant->isLeaf) {
+			int childWidth = octant->width / 2;
+			for (int i = 0; i < 8; i++) {
+				if (!octant->octants[i]) {
+					octant->octants[i] = new Octant(octant->position + getOctreeOffset(i) * float(childWidth) / 2.f, childWidth, this, octant);
+					octant->octants[i]->si = i;
+					octant->octants[i]->voxel = octant->voxel;
+				}
+				// a uniform octant hands its voxel down before being split
+				else if (octant->isAllSame) {
+					octant->octants[i]->voxel = octant->voxel;
+				}
 			}
-			std::cout << glm::to_string(octant->position) << std::endl;
-		}*/
-		
-		boost::lock_guard<boost::mutex> lock(mutex);
+			octant->isAllSame = false;
+			octant = octant->octants[octant->getChildIndexFromPos(coord)];
+		}
+		octant->voxel = voxel;
+
+		// merge back the uniform octants on the way up
+		for (Octant *parent = octant->parent; parent; parent = parent->parent) {
+			EveVoxel *sample = parent->octants[0]->voxel;
+			bool allSame = true;
+			for (Octant *child : parent->octants)
+				if (!(child->isLeaf || child->isAllSame) || child->voxel != sample)
+					allSame = false;
+
+			parent->isAllSame = allSame;
+			if (!allSame)
+				break;
+			parent->voxel = sample;
+		}
+
+		if (voxelShape) {
+			voxelShape->setSolid(cell.x, cell.y, cell.z, voxel && voxel->isOpaque());
+			// the bodies resting on or against the cell sleep on a shape that just changed under them
+			Vec3 center(coord.x, -coord.y, coord.z);
+			eveTerrain->evePhysx.activateBodiesDeferred(AABox(center - Vec3::sReplicate(1.5f), center + Vec3::sReplicate(1.5f)));
+		}
+	}
+
+	void Chunk::setStage(ChunkStage newStage) {
+		std::vector<StageWaiter> ready;
+		{
+			boost::lock_guard<boost::mutex> lock(stageMutex);
+			stage = newStage;
+
+			auto it = std::partition(stageWaiters.begin(), stageWaiters.end(), [newStage](const StageWaiter &waiter) { return waiter.target > newStage; });
+			ready.assign(it, stageWaiters.end());
+			stageWaiters.erase(it, stageWaiters.end());
+		}
+
+		for (StageWaiter &waiter : ready)
+			eveTerrain->eveScheduler.postResume(waiter.handle, waiter.lane);
+	}
+
+	bool Chunk::StageAwaiter::await_suspend(std::coroutine_handle<> handle) {
+		boost::lock_guard<boost::mutex> lock(chunk.stageMutex);
+		if (chunk.stage >= target)
+			return false; // got there between await_ready and now
+		result = true;
+		chunk.stageWaiters.push_back({target, lane, handle, &result});
+		return true;
+	}
+
+	template <int S>
+	uint8_t Chunk::getFaceAo(glm::ivec3 min, int width) {
+		constexpr int axis = EveGreedyMesher::getSideAxis(S);
+
+		// the layer in front of the face, the corner cells are one cell outside the face on both plane axes
+		glm::ivec3 front = min;
+		front[axis] = FACE_NORMALS[S][axis] < 0 ? min[axis] - 1 : min[axis] + width;
+
+		uint8_t ao = 0;
+		for (int i = 0; i < 4; i++) {
+			glm::ivec3 side1 = front, side2 = front, corner = front;
+			bool first = true;
+			for (int t = 0; t < 3; t++) {
+				if (t == axis)
+					continue;
+				int outside = FACE_CORNERS[S][i][t] > 0 ? min[t] + width : min[t] - 1;
+				int inside = FACE_CORNERS[S][i][t] > 0 ? min[t] + width - 1 : min[t];
+				side1[t] = first ? outside : inside;
+				side2[t] = first ? inside : outside;
+				corner[t] = outside;
+				first = false;
+			}
+			ao |= EveGreedyMesher::getVertexAo(
+				meshingGrid->isOccluder(side1.x, side1.y, side1.z),
+				meshingGrid->isOccluder(side2.x, side2.y, side2.z),
+				meshingGrid->isOccluder(corner.x, corner.y, corner.z)) << (i * 2);
+		}
+		return ao;
+	}
+
+	template <int S>
+	void Chunk::createFace(Octant *octant, glm::vec3 localOffset, bool marked) {
 		EASY_FUNCTION(profiler::colors::Red200);
+		unsigned int texId = octant->voxel->id + abs((int)localOffset.x) % 2 - 1;
 
-		glm::vec3 offset = octant->getChildLocalOffset();
-		int texOffset = abs((int)offset.x) % 2;
-		std::vector<EveModel::Vertex> quadVertices = {
-			{glm::vec3(-1, 0, -1), glm::vec3(0, 0, 0), glm::vec3(0, -1, 0), glm::vec2(1, 0), octant->voxel->id + texOffset - 1},
-			{glm::vec3(1, 0, 1), glm::vec3(0, 0, 0), glm::vec3(0, -1, 0), glm::vec2(0, 1), octant->voxel->id + texOffset - 1},
-			{glm::vec3(-1, 0, 1), glm::vec3(0, 0, 0), glm::vec3(0, -1, 0), glm::vec2(1, 1), octant->voxel->id + texOffset - 1},
-			{glm::vec3(1, 0, -1), glm::vec3(0, 0, 0), glm::vec3(0, -1, 0), glm::vec2(0, 0), octant->voxel->id + texOffset - 1},
-		};
-		std::vector<uint32_t> quadIndices = {0, 1, 2, 1, 0, 3};
-
-		/*if (chunkBuilder.vertices.size() == 0) {
-			std::cout << glm::to_string(octant->position) << std::endl;
-		}*/
-
-		/*eveTerrain->evePhysx.createStaticPlane(
-			glm::vec3(float(octant->width) / 2, float(octant->width) / 2, float(octant->width) / 2), 
-			position,
-			octant->getChildLocalOffset());*/
-
-		if (!octant->octantPhysxObject) {
+		if (meshingSettings->colliders && meshingSettings->colliderMode == COLLIDER_BOXES && !octant->octantPhysxObject) {
 			BoxShapeSettings floor_shape_settings(Vec3(float(octant->width) / 2, float(octant->width) / 2, float(octant->width) / 2));
 			octant->octantPhysxObject = floor_shape_settings.Create().Get();
-			chunkShapeSettings.AddShape(Vec3(offset.x, -offset.y, offset.z), Quat::sIdentity(), octant->octantPhysxObject);
+			sections[meshingSection].shapeSettings.AddShape(Vec3(localOffset.x, -localOffset.y, localOffset.z), Quat::sIdentity(), octant->octantPhysxObject);
+		}
+
+		EveModel::Builder &builder = sections[meshingSection].builder;
+
+		// packed vertices are in chunk corner space (0..CHUNK_SIZE), the chunk object is moved back by CHUNK_SIZE / 2
+		glm::vec3 center = localOffset + float(CHUNK_SIZE / 2);
+		float halfWidth = float(octant->width) / 2;
+
+		glm::ivec3 cell = glm::ivec3(glm::round(center - halfWidth));
+		uint8_t ao = getFaceAo<S>(cell, octant->width);
+
+		if (meshingSettings->renderMode == CHUNK_RENDER_FACES) {
+			// a face record is one cell deep (see chunk_face_shader.vert), positive sides start at the octant last layer
+			glm::ivec3 faceCell = cell;
+			constexpr int axis = EveGreedyMesher::getSideAxis(S);
+			if (FACE_NORMALS[S][axis] > 0)
+				faceCell[axis] += octant->width - 1;
+			builder.faces.push_back(EveModel::ChunkFace::pack(faceCell, S, octant->width, octant->width, ao, marked, texId));
+			return;
+		}
+
+		uint32_t first = static_cast<uint32_t>(builder.chunkVertices.size());
+		for (int i = 0; i < 4; i++) {
+			glm::vec3 corner(
+				FACE_CORNERS[S][i][0] + FACE_NORMALS[S][0],
+				FACE_CORNERS[S][i][1] + FACE_NORMALS[S][1],
+				FACE_CORNERS[S][i][2] + FACE_NORMALS[S][2]);
+			builder.chunkVertices.push_back(EveModel::ChunkVertex::pack(
+				glm::ivec3(glm::round(center + corner * halfWidth)),
+				S, getCornerAo(ao, i), marked, i,
+				glm::ivec2(FACE_UVS[i][0] * octant->width, FACE_UVS[i][1] * octant->width),
+				texId));
 		}
 
-		int i = 0;
-		for (EveModel::Vertex vertex : quadVertices) {
-			vertex.position = rotateV(side, vertex.position);
-			vertex.normal = rotateV(side, vertex.normal);
-			vertex.position *= float(octant->width) / 2;
-			vertex.position += offset;
-			vertex.position = offsetV(side, vertex.position, float(octant->width) / 2);
-			vertex.color = colors[i++];
-			vertex.uv *= octant->width;
-			chunkBuilder.vertices.push_back(vertex);
+		const uint32_t *indices = getQuadIndices(ao);
+		for (int i = 0; i < 6; i++)
+			builder.indices.push_back(first + indices[i]);
+	}
+
+	template <int S>
+	void Chunk::remeshSide(Octant *octant, glm::vec3 localOffset, std::vector<Octant *> &neighbors) {
+		if constexpr (S == 3) {
+			if (octant->position == glm::vec3(7.5, -2.5, -38.5)) {
+				octant->marked = true;
+			}
 		}
 
-		for (uint32_t index : quadIndices) {
-			index += chunkBuilder.vertices.size() - i;
-			chunkBuilder.indices.push_back(index);
+		constexpr int axis = EveGreedyMesher::getSideAxis(S);
+		glm::ivec3 min = glm::ivec3(glm::round(localOffset + float(CHUNK_SIZE / 2) - float(octant->width) / 2));
+		bool onBorder = FACE_NORMALS[S][axis] < 0 ? min[axis] == 0 : min[axis] + octant->width == CHUNK_SIZE;
+
+		// the neighbor chunk is only seen through the halo, any air cell in front of the face exposes it
+		if (onBorder) {
+			glm::ivec3 front = min;
+			front[axis] = FACE_NORMALS[S][axis] < 0 ? -1 : CHUNK_SIZE;
+			constexpr int uAxis = (axis + 1) % 3;
+			constexpr int vAxis = (axis + 2) % 3;
+
+			if (meshingHalo->get(front) == ChunkHalo::UNKNOWN) // no neighbor chunk, like an empty neighbor list
+				return;
+
+			bool exposed = false;
+			for (int v = 0; v < octant->width && !exposed; v++) {
+				for (int u = 0; u < octant->width && !exposed; u++) {
+					glm::ivec3 cell = front;
+					cell[uAxis] += u;
+					cell[vAxis] += v;
+					uint16_t type = meshingHalo->get(cell);
+					exposed = type == ChunkHalo::AIR || meshingGrid->isTranslucent(type);
+				}
+			}
+
+			if ((exposed && octant->voxel->isOpaque()) || octant->forceRender)
+				createFace<S>(octant, localOffset, octant->marked);
+			return;
+		}
+
+		neighbors.clear();
+		octant->getNeighbors<S>(neighbors);
+
+		if (neighbors.size() == 1) { // same size
+			// translucent octants are meshed apart, they expose the faces behind them like air
+			if ((neighbors.front()->voxel && !neighbors.front()->voxel->isOpaque() &&
+				octant->voxel->isOpaque()) || octant->forceRender) {
+				createFace<S>(octant, localOffset, octant->marked);
+			}
+		}
+		else if (neighbors.size() > 1) { 
+			bool allSolid = true;
+			for (Octant* oct : neighbors) {
+				if (oct->voxel && !oct->voxel->isOpaque()) {
+					allSolid = false;
+				}
+			}
+			if (!allSolid || octant->forceRender) {
+				if (octant->voxel->isOpaque() || octant->forceRender) {
+					createFace<S>(octant, localOffset, octant->marked);
+				}
+			}
 		}
 	}
 
-	void Chunk::remesh2rec(Octant *octant, bool rec) {
+	void Chunk::remesh2rec(Octant *octant, glm::vec3 localOffset, bool rec) {
 
 		if (!octant->isAllSame) {
 			if (rec) {
-				for (Octant *oct : octant->octants) {
-					if (oct)
-						remesh2rec(oct);
+				float childHalfWidth = float(octant->width) / 4;
+				for (int i = 0; i < 8; i++) {
+					if (octant->octants[i])
+						remesh2rec(octant->octants[i], localOffset + getOctreeOffset(i) * childHalfWidth);
 				}
 			}
 		}
 		
 
-		std::vector<OctantSide> sidesToCheck;
-
-		if (eveTerrain->sidesToRemesh[0])
-			sidesToCheck.push_back(OctantSides::Top);
-		if (eveTerrain->sidesToRemesh[1])
-			sidesToCheck.push_back(OctantSides::Down);
-		if (eveTerrain->sidesToRemesh[2])
-			sidesToCheck.push_back(OctantSides::Left);
-		if (eveTerrain->sidesToRemesh[3])
-			sidesToCheck.push_back(OctantSides::Right);
-		if (eveTerrain->sidesToRemesh[4])
-			sidesToCheck.push_back(OctantSides::Near);
-		if (eveTerrain->sidesToRemesh[5])
-			sidesToCheck.push_back(OctantSides::Far);
-
 		if (octant->isAllSame || octant->isLeaf || octant->forceRender) {
 			EASY_BLOCK("Worth considering for render");
 
-			for (const OctantSide side : sidesToCheck) {
+			// reused by every side of every octant, the neighbor lookups only append to it
+			thread_local std::vector<Octant *> neighbors;
+
+			if (meshingSettings->sideMask & (1 << 0))
+				remeshSide<0>(octant, localOffset, neighbors);
+			if (meshingSettings->sideMask & (1 << 1))
+				remeshSide<1>(octant, localOffset, neighbors);
+			if (meshingSettings->sideMask & (1 << 2))
+				remeshSide<2>(octant, localOffset, neighbors);
+			if (meshingSettings->sideMask & (1 << 3))
+				remeshSide<3>(octant, localOffset, neighbors);
+			if (meshingSettings->sideMask & (1 << 4))
+				remeshSide<4>(octant, localOffset, neighbors);
+			if (meshingSettings->sideMask & (1 << 5))
+				remeshSide<5>(octant, localOffset, neighbors);
+		}
+	}
 
-				if (octant->position == glm::vec3(7.5, -2.5, -38.5) && side.direction == -2) {
-					octant->marked = true;
-				}
+	// the section colliders are rebuilt from scratch, octants only add their box once per rebuild
+	static void clearColliders(Octant *octant) {
+		if (!octant)
+			return;
+		octant->octantPhysxObject = nullptr;
+		for (Octant *child : octant->octants)
+			clearColliders(child);
+	}
 
-				if (side.direction == OctantSides::Top.direction) {
-					if (octant->container->eveTerrain->playerCurrentLevel == floor(octant->position.y - octant->width)) {
-						octant->marked = true;
-						//std::cout << "m";
-					}
-				}
+	ChunkMeshingSettings Chunk::getMeshingSettings(EveTerrainMeshingMode meshingMode) {
+		ChunkMeshingSettings settings;
+		settings.meshingMode = meshingMode;
+		settings.renderMode = eveTerrain->chunkRenderMode;
+		settings.colliderMode = eveTerrain->colliderMode;
+		settings.colliders = collidersWanted;
+		settings.sideMask = 0;
+		for (int side = 0; side < 6; side++)
+			if (eveTerrain->sidesToRemesh[side])
+				settings.sideMask |= 1 << side;
+		settings.lod = meshingMode == MESHING_GREEDY ? lod.load() : 0;
+		settings.capLayer = eveTerrain->getCutLayer(*this);
+		settings.voxelMap = &eveTerrain->voxelMap;
+		settings.cubeModel = eveTerrain->eveCube;
+		return settings;
+	}
 
-				std::vector<Octant *> neighbors = octant->getNeighbors(side);
+	uint8_t Chunk::beginRemesh(const ChunkMeshingSettings &settings) {
+		uint8_t sectionMask = dirtySections.exchange(0);
+		if (!sectionMask)
+			sectionMask = ALL_SECTIONS;
 
-				if (neighbors.size() == 1) { // same size
-					if ((neighbors.front()->voxel == eveTerrain->voxelMap[0] &&
-						octant->voxel != eveTerrain->voxelMap[0]) || octant->forceRender) {
-						if (!octant->marked) {
-							createFace(octant, WHITE, side);
-						}
-						else {
-							createFace(octant, MARK, side);
-						}
-					}
-				}
-				/*else if (neighbors.size() == 0) { // top or down level
-					if (octant->voxel != eveTerrain->voxelMap[0] || octant->forceRender) {
-						if (octant->container->neighbors[side.neighborDirection]) {
-							if (octant->container->neighbors[side.neighborDirection]->root->voxel == eveTerrain->voxelMap[0]) {
-								if (!octant->marked) {
-									createFace(octant, WHITE, side);
-								}
-								else {createFace(octant, MARK, side);}
-							}
-						} else {
-							//if (!neighbors[side.neighborDirection]) {
-								if (!octant->marked) {
-									createFace(octant, WHITE, side);
-								}
-								else {createFace(octant, MARK, side);}
-							//}
-						}
-					}
-				}*/
-				else if (neighbors.size() > 1) { 
-					bool allSolid = true;
-					for (Octant* oct : neighbors) {
-						if (oct->voxel == eveTerrain->voxelMap[0]) {
-							allSolid = false;
-						}
-					}
-					if (!allSolid || octant->forceRender) {
-						if (octant->voxel != eveTerrain->voxelMap[0] || octant->forceRender) {
-							if (!octant->marked) {
-								createFace(octant, WHITE, side);
-							}
-							else {
-								createFace(octant, MARK, side);
-							}
-						}
-					}
+		{
+			boost::lock_guard<boost::mutex> chunkLock(mutex);
+			// a full remesh hides the chunk until it's integrated again, unless it's drawn already (lod swap, edits)
+			bool hide = sectionMask == ALL_SECTIONS && (isQueued || stage != CHUNK_STAGE_UPLOADED);
+			if (hide) {
+				isQueued = true;
+				eveTerrain->retireModel(std::move(capModel));
+				capModel.reset();
+				eveTerrain->retireModel(std::move(translucentModel));
+				translucentModel.reset();
+				chunkObjectMap.clear();
+				// back to noised without waking anyone, the waiters want the new mesh
+				boost::lock_guard<boost::mutex> stageLock(stageMutex);
+				if (stage > CHUNK_STAGE_NOISED)
+					stage = CHUNK_STAGE_NOISED;
+			}
+
+			// visible chunks keep drawing the previous section meshes until the new ones are integrated
+			if (hide) {
+				for (int i = 0; i < SECTION_COUNT; i++) {
+					if (!(sectionMask & (1 << i)))
+						continue;
+
+					ChunkSection &section = sections[i];
+					eveTerrain->retireModel(std::move(section.model));
+					section.model.reset();
+					section.hasObject = false;
 				}
 			}
+			uploadSections &= ~sectionMask;
+		}
+
+		// the voxel shape replaces every section collider, not only the remeshed ones, and so does no collider at all
+		bool allColliders = !settings.colliders || settings.colliderMode == COLLIDER_VOXEL_SHAPE;
+		removeSectionBodies(allColliders ? ALL_SECTIONS : sectionMask);
+		// back to boxes, the section compounds take over
+		if (!settings.colliders || settings.colliderMode != COLLIDER_VOXEL_SHAPE)
+			destroyVoxelBody();
+		return sectionMask;
+	}
+
+	void Chunk::resetSections(uint8_t sectionMask) {
+		boost::lock_guard<boost::mutex> chunkLock(mutex);
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			if (!(sectionMask & (1 << i)))
+				continue;
+
+			ChunkSection &section = sections[i];
+			releasePendingMesh(section);
+			// a fresh settings, jolt caches the shape of the previous one
+			section.shapeSettings = MutableCompoundShapeSettings();
+			clearColliders(root->octants[i]);
+		}
+	}
+
+	void Chunk::finishRemesh(uint8_t sectionMask, const ChunkMeshingSettings &settings) {
+		if (settings.colliders) {
+			createSectionBodies(sectionMask);
+			// built once, the edits update it in place
+			if (settings.colliderMode == COLLIDER_VOXEL_SHAPE && voxelBody.IsInvalid())
+				createVoxelBody();
+		}
+
+		EASY_BLOCK("Push chunk object");
+		boost::lock_guard<boost::mutex> terrainLock(eveTerrain->mutex);
+		boost::lock_guard<boost::mutex> chunkLock(mutex);
+
+		eveTerrain->remeshingProcessing.erase(
+			std::find(eveTerrain->remeshingProcessing.begin(),
+			eveTerrain->remeshingProcessing.end(),
+			this));
+
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			if (!(sectionMask & (1 << i)))
+				continue;
+
+			ChunkSection &section = sections[i];
+			section.pendingMeshBytes = section.builder.vertices.capacity() * sizeof(EveModel::Vertex)
+				+ section.builder.chunkVertices.capacity() * sizeof(EveModel::ChunkVertex)
+				+ section.builder.faces.capacity() * sizeof(uint64_t)
+				+ section.builder.indices.capacity() * sizeof(uint32_t);
+			eveTerrain->pendingMeshBytes += section.pendingMeshBytes;
 		}
+		uploadSections |= sectionMask;
+
+		eveTerrain->remeshingProcessed.push_back(this);
+		// a remesh of an uploaded chunk (sections, lod swap) doesn't go through the stages again
+		if (sectionMask == ALL_SECTIONS && stage < CHUNK_STAGE_MESHED)
+			setStage(CHUNK_STAGE_MESHED);
 	}
 
 	void Chunk::remesh2(Chunk *chunk) {
-		//std::cout << chunk->id << "s" << std::endl;
 		EASY_BLOCK("Remesh V2");
 		EASY_FUNCTION(profiler::colors::Blue100);
+		chunk->remeshSections(MESHING_CHUNK);
+	}
+
+	void Chunk::remeshGreedy(Chunk *chunk) {
+		EASY_BLOCK("Remesh Greedy");
+		EASY_FUNCTION(profiler::colors::Blue100);
+		chunk->remeshSections(MESHING_GREEDY);
+	}
+
+	void Chunk::remeshSections(EveTerrainMeshingMode meshingMode) {
+		ChunkMeshingSettings settings = getMeshingSettings(meshingMode);
+		uint8_t sectionMask = beginRemesh(settings);
+
+		thread_local ChunkHalo halo;
+		snapshotHalo(halo);
+		mesh(sectionMask, halo, settings);
+		finishRemesh(sectionMask, settings);
+	}
+
+	// one grid per worker, it keeps its buffers between chunks (remeshes and cap jobs)
+	static thread_local EveGreedyMesher workerGrid;
+
+	void Chunk::mesh(uint8_t sectionMask, const ChunkHalo &halo, const ChunkMeshingSettings &settings) {
+		EASY_FUNCTION(profiler::colors::Blue100);
+
+		if (settings.meshingMode == MESHING_OCTANT) {
+			{
+				boost::lock_guard<boost::mutex> lock(mutex);
+				chunkObjectMap.clear();
+			}
+			addCubes(root, settings.cubeModel);
+			return;
+		}
+
+		resetSections(sectionMask);
+
+		// the caps, the translucent faces and the face ao come from the grid whatever the meshing mode
+		EveGreedyMesher &grid = workerGrid;
+		meshingSettings = &settings;
+		meshingHalo = &halo;
+		meshingGrid = &grid;
 		{
-			boost::lock_guard<boost::mutex> chunkLock(chunk->mutex);
-			chunk->isQueued = true;
-			chunk->chunkBuilder.indices.clear();
-			chunk->chunkBuilder.vertices.clear();
-			chunk->chunkObjectMap.clear();
-			chunk->chunkModel.reset();
+			// one lock for the whole traversal, the renderer skips queued chunks anyway
+			EASY_BLOCK("Fill voxel grid");
+			boost::lock_guard<boost::mutex> lock(mutex);
+			fillMesher(grid, halo, settings);
+			if (settings.meshingMode == MESHING_CHUNK)
+				meshOctree(sectionMask);
 		}
+		if (settings.meshingMode == MESHING_GREEDY)
+			meshGreedy(grid, sectionMask);
+		meshingSettings = nullptr;
+		meshingHalo = nullptr;
+		meshingGrid = nullptr;
+
+		if (settings.colliders && settings.colliderMode == COLLIDER_MERGED_BOXES)
+			buildMergedColliders(sectionMask);
+
+		buildCaps(grid, settings.capLayer, settings.renderMode == CHUNK_RENDER_FACES);
+		buildTranslucent(grid);
+
+		boost::lock_guard<boost::mutex> lock(mutex);
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			if (!(sectionMask & (1 << i)))
+				continue;
 
-		if (!chunkPhysxObject.IsInvalid()) {
-			eveTerrain->evePhysx.body_interface->RemoveBody(chunkPhysxObject);
-			eveTerrain->evePhysx.body_interface->DestroyBody(chunkPhysxObject);
+			ChunkSection &section = sections[i];
+			section.builder.groupBySide();
+			section.lastFaceCount = section.builder.faces.size() + section.builder.chunkVertices.size() / 4;
 		}
+	}
 
-		remesh2rec(chunk->root);
+	void Chunk::meshOctree(uint8_t sectionMask) {
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			if (!(sectionMask & (1 << i)) || !root->octants[i])
+				continue;
 
+			meshingSection = i;
+			ChunkSection &section = sections[i];
+			if (meshingSettings->renderMode == CHUNK_RENDER_FACES) {
+				section.builder.faces.reserve(section.lastFaceCount);
+			}
+			else {
+				section.builder.chunkVertices.reserve(section.lastFaceCount * 4);
+				section.builder.indices.reserve(section.lastFaceCount * 6);
+			}
+			remesh2rec(root->octants[i], getOctreeOffset(i) * float(SECTION_SIZE / 2));
+		}
+	}
+
+	uint16_t Chunk::getLodType(Octant *octant) {
+		if (!octant)
+			return EveGreedyMesher::AIR;
+
+		if (octant->isLeaf || octant->isAllSame)
+			return octant->voxel ? static_cast<uint16_t>(octant->voxel->id) : EveGreedyMesher::AIR;
+
+		// half of the children or more solid makes the octant solid, with the most common of their types
+		uint16_t types[8];
+		int solid = 0;
+		for (Octant *child : octant->octants) {
+			uint16_t type = getLodType(child);
+			if (type != EveGreedyMesher::AIR)
+				types[solid++] = type;
+		}
+		if (solid < 4)
+			return EveGreedyMesher::AIR;
+
+		uint16_t best = types[0];
+		int bestCount = 0;
+		for (int i = 0; i < solid; i++) {
+			int count = static_cast<int>(std::count(types, types + solid, types[i]));
+			if (count > bestCount) {
+				best = types[i];
+				bestCount = count;
+			}
+		}
+		return best;
+	}
+
+	// voxel ids of the octree, whole octants are filled at once (octants of the lod width are collapsed)
+	static void fillGreedyMesher(EveGreedyMesher &mesher, Octant *octant, glm::vec3 rootPosition, int lodWidth) {
+		if (!octant)
+			return;
+
+		if (octant->isLeaf || octant->isAllSame || octant->width <= lodWidth) {
+			uint16_t type = Chunk::getLodType(octant);
+			glm::ivec3 min = glm::ivec3(glm::floor(octant->position - rootPosition - float(octant->width) / 2)) + CHUNK_SIZE / 2;
+			mesher.fill(min.x, min.y, min.z, min.x + octant->width, min.y + octant->width, min.z + octant->width, type);
+			return;
+		}
+
+		for (Octant *child : octant->octants)
+			fillGreedyMesher(mesher, child, rootPosition, lodWidth);
+	}
+
+	// calls solid(min, width) for every opaque leaf or uniform octant, full resolution: the colliders don't follow the lod
+	template <typename F>
+	static void forEachOpaqueBlock(Octant *octant, glm::vec3 rootPosition, F &&solid) {
+		if (!octant)
+			return;
+
+		if (octant->isLeaf || octant->isAllSame) {
+			if (octant->voxel && octant->voxel->isOpaque())
+				solid(glm::ivec3(glm::floor(octant->position - rootPosition - float(octant->width) / 2)) + CHUNK_SIZE / 2, octant->width);
+			return;
+		}
+
+		for (Octant *child : octant->octants)
+			forEachOpaqueBlock(child, rootPosition, solid);
+	}
+
+	static void fillVoxelShape(EveVoxelShape &shape, Octant *root) {
+		forEachOpaqueBlock(root, root->position, [&shape](glm::ivec3 min, int width) {
+			for (int z = min.z; z < min.z + width; z++)
+				for (int y = min.y; y < min.y + width; y++)
+					for (int x = min.x; x < min.x + width; x++)
+						shape.setSolid(x, y, z, true);
+		});
+	}
+
+	void Chunk::createVoxelBody() {
+		EASY_FUNCTION(profiler::colors::Orange);
+		Ref<EveVoxelShape> shape = new EveVoxelShape();
 		{
-			Ref<Shape> chunkShape = chunkShapeSettings.Create().Get();
+			// published under the mutex, an edit after the fill already goes to the shape
+			boost::lock_guard<boost::mutex> chunkLock(mutex);
+			fillVoxelShape(*shape, root);
+			voxelShape = shape;
+		}
+
+		BodyCreationSettings settings(shape, RVec3(root->position.x, -root->position.y, root->position.z), Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING);
+		voxelBody = eveTerrain->evePhysx.createBodyDeferred(settings);
+	}
+
+	void Chunk::buildMergedColliders(uint8_t sectionMask) {
+		EASY_FUNCTION(profiler::colors::Orange);
+
+		// bit y of column x + z * CHUNK_SIZE: opaque cell not taken by a box yet
+		std::array<uint16_t, CHUNK_SIZE * CHUNK_SIZE> columns{};
+		{
+			boost::lock_guard<boost::mutex> chunkLock(mutex);
+			forEachOpaqueBlock(root, root->position, [&columns](glm::ivec3 min, int width) {
+				uint16_t bits = uint16_t(((1 << width) - 1) << min.y);
+				for (int z = min.z; z < min.z + width; z++)
+					for (int x = min.x; x < min.x + width; x++)
+						columns[x + z * CHUNK_SIZE] |= bits;
+			});
+		}
+
+		auto isFree = [&columns](int x, int y, int z) { return (columns[x + z * CHUNK_SIZE] >> y) & 1; };
+
+		// greedy 3d merge, each box grows along x, then z by whole rows, then y by whole slabs
+		// the boxes stay inside their section so a section is rebuilt alone
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			if (!(sectionMask & (1 << i)))
+				continue;
+
+			ChunkSection &section = sections[i];
+			glm::ivec3 sectionMin = getSectionMin(i);
+			glm::ivec3 sectionMax = sectionMin + SECTION_SIZE;
+			for (int y = sectionMin.y; y < sectionMax.y; y++) {
+				for (int z = sectionMin.z; z < sectionMax.z; z++) {
+					for (int x = sectionMin.x; x < sectionMax.x; x++) {
+						if (!isFree(x, y, z))
+							continue;
+
+						int endX = x + 1;
+						while (endX < sectionMax.x && isFree(endX, y, z))
+							endX++;
+
+						auto rowFree = [&](int rowY, int rowZ) {
+							for (int rowX = x; rowX < endX; rowX++)
+								if (!isFree(rowX, rowY, rowZ))
+									return false;
+							return true;
+						};
+						int endZ = z + 1;
+						while (endZ < sectionMax.z && rowFree(y, endZ))
+							endZ++;
+
+						auto slabFree = [&](int slabY) {
+							for (int slabZ = z; slabZ < endZ; slabZ++)
+								if (!rowFree(slabY, slabZ))
+									return false;
+							return true;
+						};
+						int endY = y + 1;
+						while (endY < sectionMax.y && slabFree(endY))
+							endY++;
+
+						uint16_t bits = uint16_t(((1 << (endY - y)) - 1) << y);
+						for (int boxZ = z; boxZ < endZ; boxZ++)
+							for (int boxX = x; boxX < endX; boxX++)
+								columns[boxX + boxZ * CHUNK_SIZE] &= ~bits;
+
+						// same space as the octant boxes: center relative to the root, y up
+						glm::vec3 size(endX - x, endY - y, endZ - z);
+						glm::vec3 center = glm::vec3(x, y, z) + size / 2.f - float(CHUNK_SIZE / 2);
+						BoxShapeSettings boxShapeSettings(Vec3(size.x / 2, size.y / 2, size.z / 2));
+						section.shapeSettings.AddShape(Vec3(center.x, -center.y, center.z), Quat::sIdentity(), boxShapeSettings.Create().Get());
+					}
+				}
+			}
+		}
+	}
+
+	void Chunk::createSectionBodies(uint8_t sectionMask) {
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			ChunkSection &section = sections[i];
+			// empty sections (air) have no collider at all
+			if (!(sectionMask & (1 << i)) || section.shapeSettings.mSubShapes.empty())
+				continue;
+
+			Ref<Shape> chunkShape = section.shapeSettings.Create().Get();
 
 			RotatedTranslatedShapeSettings translatedChunkShapeSettings(Vec3(root->position.x, -root->position.y, root->position.z), Quat::sIdentity(), chunkShape);
 			Ref<Shape> translatedChunkShape = translatedChunkShapeSettings.Create().Get();
 
 			BodyCreationSettings chunkSettings(translatedChunkShape, Vec3(0, 0, 0), Quat::sIdentity(), EMotionType::Static, Layers::NON_MOVING);
-			BodyID id = eveTerrain->evePhysx.body_interface->CreateAndAddBody(chunkSettings, EActivation::DontActivate);
-			chunkPhysxObject = id;
+			section.physxObject = eveTerrain->evePhysx.createBodyDeferred(chunkSettings);
+		}
+	}
+
+	void Chunk::removeSectionBodies(uint8_t sectionMask) {
+		for (int i = 0; i < SECTION_COUNT; i++) {
+			ChunkSection &section = sections[i];
+			if (!(sectionMask & (1 << i)) || section.physxObject.IsInvalid())
+				continue;
+			eveTerrain->evePhysx.removeBodyDeferred(section.physxObject);
+			section.physxObject = BodyID();
+		}
+	}
+
+	void Chunk::updateColliders() {
+		EASY_FUNCTION(profiler::colors::Orange);
+		{
+			boost::lock_guard<boost::mutex> chunkLock(mutex);
+			for (int i = 0; i < SECTION_COUNT; i++) {
+				sections[i].shapeSettings = MutableCompoundShapeSettings();
+				clearColliders(root->octants[i]);
+			}
+		}
+		removeSectionBodies(ALL_SECTIONS);
+		destroyVoxelBody();
+
+		// the octant boxes come with a mesh, the terrain remeshes the chunk for them instead
+		if (collidersWanted) {
+			EveChunkColliderMode colliderMode = eveTerrain->colliderMode;
+			if (colliderMode == COLLIDER_MERGED_BOXES) {
+				buildMergedColliders(ALL_SECTIONS);
+				createSectionBodies(ALL_SECTIONS);
+			}
+			else if (colliderMode == COLLIDER_VOXEL_SHAPE) {
+				createVoxelBody();
+			}
 		}
 
-		EASY_BLOCK("Push chunk object");
-		EveTerrain *eveTerrain = chunk->eveTerrain;
 		boost::lock_guard<boost::mutex> terrainLock(eveTerrain->mutex);
+		eveTerrain->colliderProcessing.erase(std::find(eveTerrain->colliderProcessing.begin(), eveTerrain->colliderProcessing.end(), this));
+	}
+
+	void Chunk::destroyVoxelBody() {
+		if (voxelBody.IsInvalid())
+			return;
+		eveTerrain->evePhysx.removeBodyDeferred(voxelBody);
+		voxelBody = BodyID();
+
 		boost::lock_guard<boost::mutex> chunkLock(mutex);
+		voxelShape = nullptr;
+	}
 
-		eveTerrain->remeshingProcessing.erase(
-			std::find(eveTerrain->remeshingProcessing.begin(),
-			eveTerrain->remeshingProcessing.end(),
-			this));
-		
+	// the octree at the lod and the neighbors halo, the chunk mutex is held by the caller
+	void Chunk::fillMesher(EveGreedyMesher &mesher, const ChunkHalo &halo, const ChunkMeshingSettings &settings) {
+		mesher.clear();
+		for (EveVoxel *voxel : *settings.voxelMap)
+			mesher.setTranslucent(static_cast<uint16_t>(voxel->id), voxel->translucent);
+		fillGreedyMesher(mesher, root, root->position, 1 << settings.lod);
+
+		// the padding is the neighbors halo (at their lod, see snapshotHalo), edges and corners included for the ao
+		// a missing neighbor hides the border faces like the octree meshers do
+		for (int z = -1; z <= CHUNK_SIZE; z++) {
+			for (int y = -1; y <= CHUNK_SIZE; y++) {
+				for (int x = -1; x <= CHUNK_SIZE; x++) {
+					int outside = (x < 0 || x >= CHUNK_SIZE) + (y < 0 || y >= CHUNK_SIZE) + (z < 0 || z >= CHUNK_SIZE);
+					if (!outside)
+						continue;
+
+					mesher.set(x, y, z, halo.get(glm::ivec3(x, y, z)));
+				}
+			}
+		}
+	}
+
+	// size of the cells box a merged face covers, one cell thick along its normal
+	static glm::vec3 getQuadSize(const EveGreedyMesher::Quad &quad) {
+		int axis = EveGreedyMesher::getSideAxis(quad.side);
+		int uAxis, vAxis;
+		EveGreedyMesher::getPlaneAxes(axis, uAxis, vAxis);
+
+		glm::vec3 size(1);
+		size[uAxis] = quad.width;
+		size[vAxis] = quad.height;
+		return size;
+	}
+
+	// center of the face plane in chunk corner space
+	static glm::vec3 getQuadCenter(const EveGreedyMesher::Quad &quad) {
+		const int (&normal)[3] = FACE_NORMALS[quad.side];
+		return glm::vec3(quad.x, quad.y, quad.z) + getQuadSize(quad) / 2.f + glm::vec3(normal[0], normal[1], normal[2]) * .5f;
+	}
+
+	// a merged face of the greedy mesher in chunk corner space, like createFace
+	static void appendQuad(EveModel::Builder &builder, const EveGreedyMesher::Quad &quad, bool faceRecords) {
+		int axis = EveGreedyMesher::getSideAxis(quad.side);
+		int uAxis, vAxis;
+		EveGreedyMesher::getPlaneAxes(axis, uAxis, vAxis);
+
+		glm::vec3 size = getQuadSize(quad);
+		glm::vec3 faceCenter = getQuadCenter(quad);
+		unsigned int texId = quad.type - 1;
+
+		// mesher plane corners to the FACE_CORNERS order
+		uint8_t ao = 0;
+		for (int i = 0; i < 4; i++) {
+			int planeCorner = (FACE_CORNERS[quad.side][i][uAxis] > 0 ? 1 : 0) | (FACE_CORNERS[quad.side][i][vAxis] > 0 ? 2 : 0);
+			ao |= getCornerAo(quad.ao, planeCorner) << (i * 2);
+		}
+
+		if (faceRecords) {
+			builder.faces.push_back(EveModel::ChunkFace::pack(glm::ivec3(quad.x, quad.y, quad.z), quad.side, quad.width, quad.height, ao, false, texId));
+			return;
+		}
+
+		uint32_t first = static_cast<uint32_t>(builder.chunkVertices.size());
+		for (int i = 0; i < 4; i++) {
+			const int (&corner)[3] = FACE_CORNERS[quad.side][i];
+			glm::ivec2 uv(
+				FACE_UVS[i][0] * int(size[FACE_UV_AXES[quad.side][0]]),
+				FACE_UVS[i][1] * int(size[FACE_UV_AXES[quad.side][1]]));
+			builder.chunkVertices.push_back(EveModel::ChunkVertex::pack(
+				glm::ivec3(glm::round(faceCenter + glm::vec3(corner[0], corner[1], corner[2]) * size / 2.f)),
+				quad.side, getCornerAo(ao, i), false, i, uv, texId));
+		}
+		const uint32_t *indices = getQuadIndices(ao);
+		for (int i = 0; i < 6; i++)
+			builder.indices.push_back(first + indices[i]);
+	}
+
+	void Chunk::buildCaps(EveGreedyMesher &mesher, int layer, bool faceRecords) {
+		EASY_BLOCK("Build cut caps");
+		thread_local EveModel::Builder caps;
+		thread_local std::vector<EveGreedyMesher::Quad> quads;
+
+		caps.faces.clear();
+		caps.chunkVertices.clear();
+		caps.indices.clear();
+		caps.layerOffsets.clear();
+		if (layer >= 0) {
+			// the other layers get empty ranges, drawLayer draws nothing for them
+			quads.clear();
+			mesher.meshCut(quads, layer);
+			for (const EveGreedyMesher::Quad &quad : quads)
+				appendQuad(caps, quad, faceRecords);
+			caps.layerOffsets.assign(layer + 1, 0);
+			caps.layerOffsets.resize(CHUNK_SIZE + 1, static_cast<uint32_t>(faceRecords ? caps.faces.size() : caps.indices.size()));
+		}
+
+		boost::lock_guard<boost::mutex> lock(mutex);
+		std::swap(capBuilder, caps);
+		capLayer = layer;
+		uploadCaps = true;
+	}
+
+	void Chunk::updateCaps() {
+		EASY_FUNCTION(profiler::colors::Orange);
+		ChunkMeshingSettings settings = getMeshingSettings(eveTerrain->chunkPool.meshingMode);
+
+		thread_local ChunkHalo halo;
+		snapshotHalo(halo);
+		{
+			boost::lock_guard<boost::mutex> lock(mutex);
+			fillMesher(workerGrid, halo, settings);
+		}
+		buildCaps(workerGrid, settings.capLayer, settings.renderMode == CHUNK_RENDER_FACES);
+
+		// uploaded with the meshes, under the same budget
+		boost::lock_guard<boost::mutex> terrainLock(eveTerrain->mutex);
+		eveTerrain->capProcessing.erase(std::find(eveTerrain->capProcessing.begin(), eveTerrain->capProcessing.end(), this));
 		eveTerrain->remeshingProcessed.push_back(this);
-		/*std::cout << "Finished chunk id:" << id 
-			<< " remeshing " << glm::to_string(this->position) 
-			<< " vertices: " << chunkBuilder.vertices.size() 
-			<< std::endl;*/
-		
-		//std::cout << chunk->id << "e" << std::endl;
 	}
-}
\ No newline at end of file
+
+	void Chunk::buildTranslucent(EveGreedyMesher &mesher) {
+		EASY_BLOCK("Build translucent faces");
+		thread_local std::vector<EveGreedyMesher::Quad> quads;
+		quads.clear();
+		mesher.meshTranslucent(quads);
+
+		// sorted and uploaded by the terrain once integrated, the previous ones are drawn until then
+		boost::lock_guard<boost::mutex> lock(mutex);
+		translucentQuads.assign(quads.begin(), quads.end());
+		uploadTranslucent = true;
+	}
+
+	void Chunk::sortTranslucent(glm::vec3 eye, EveModel::Builder &builder, bool faceRecords) {
+		EASY_FUNCTION(profiler::colors::Blue100);
+		glm::vec3 localEye = eye - (glm::vec3(position) - float(CHUNK_SIZE / 2));
+
+		// farthest first, blending draws over what's behind
+		thread_local std::vector<std::pair<float, uint32_t>> order;
+		order.clear();
+		for (uint32_t i = 0; i < translucentQuads.size(); i++) {
+			glm::vec3 offset = getQuadCenter(translucentQuads[i]) - localEye;
+			order.emplace_back(glm::dot(offset, offset), i);
+		}
+		std::sort(order.begin(), order.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+		builder.faces.clear();
+		builder.chunkVertices.clear();
+		builder.indices.clear();
+		for (const auto &entry : order)
+			appendQuad(builder, translucentQuads[entry.second], faceRecords);
+	}
+
+	void Chunk::meshGreedy(EveGreedyMesher &mesher, uint8_t sectionMask) {
+		static constexpr float HALF = CHUNK_SIZE / 2;
+		thread_local std::vector<EveGreedyMesher::Quad> quads;
+
+		bool faceRecords = meshingSettings->renderMode == CHUNK_RENDER_FACES;
+		bool boxColliders = meshingSettings->colliders && meshingSettings->colliderMode == COLLIDER_BOXES;
+		for (int sectionIndex = 0; sectionIndex < SECTION_COUNT; sectionIndex++) {
+			if (!(sectionMask & (1 << sectionIndex)) || !root->octants[sectionIndex])
+				continue;
+
+			// the mesher region keeps the merged faces inside the section
+			glm::ivec3 sectionMin = getSectionMin(sectionIndex);
+			quads.clear();
+			mesher.mesh(quads, meshingSettings->sideMask, sectionMin.x, sectionMin.y, sectionMin.z, SECTION_SIZE);
+
+			EASY_BLOCK("Build greedy vertices");
+			boost::lock_guard<boost::mutex> lock(mutex);
+
+			ChunkSection &section = sections[sectionIndex];
+			if (faceRecords) {
+				section.builder.faces.reserve(quads.size());
+			}
+			else {
+				section.builder.chunkVertices.reserve(quads.size() * 4);
+				section.builder.indices.reserve(quads.size() * 6);
+			}
+
+			for (const EveGreedyMesher::Quad &quad : quads) {
+				appendQuad(section.builder, quad, faceRecords);
+				if (!boxColliders)
+					continue;
+
+				// colliders straight from the grid, one slab per merged face covering its solid cells
+				int axis = EveGreedyMesher::getSideAxis(quad.side);
+				int uAxis, vAxis;
+				EveGreedyMesher::getPlaneAxes(axis, uAxis, vAxis);
+
+				glm::vec3 size(1.f);
+				size[uAxis] = quad.width;
+				size[vAxis] = quad.height;
+				glm::vec3 offset = glm::vec3(quad.x, quad.y, quad.z) + size * .5f - HALF;
+				BoxShapeSettings boxShapeSettings(Vec3(size.x / 2, size.y / 2, size.z / 2));
+				section.shapeSettings.AddShape(Vec3(offset.x, -offset.y, offset.z), Quat::sIdentity(), boxShapeSettings.Create().Get());
+			}
+		}
+	}
+}
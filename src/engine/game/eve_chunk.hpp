@@ -12,17 +12,23 @@
 #include <boost/range/join.hpp>
 #include "eve_model.hpp"
 #include "eve_physx.hpp"
+#include "../utils/eve_enums.hpp"
+#include "../utils/eve_task.hpp"
+#include "eve_greedy_mesher.hpp"
+#include "eve_voxel_shape.hpp"
+
+#include <array>
+#include <atomic>
 
 namespace eve {
 	static constexpr int MAX_RESOLUTION = 1;
 	static constexpr int CHUNK_SIZE = 16;
 	static constexpr int MAX_THREADS = 16;
+	static_assert(EveGreedyMesher::SIZE == CHUNK_SIZE, "The greedy mesher works on whole chunks");
 
 	static const std::vector<glm::vec3> RED = {glm::vec3(1, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 0, 0)};
 	static const std::vector<glm::vec3> GREEN = {glm::vec3(0, 1, 0), glm::vec3(0, 1, 0), glm::vec3(0, 1, 0), glm::vec3(0, 1, 0)};
 	static const std::vector<glm::vec3> BLUE = {glm::vec3(0, 0, 1), glm::vec3(0, 0, 1), glm::vec3(0, 0, 1), glm::vec3(0, 0, 1)};
-	static const std::vector<glm::vec3> MARK = {glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, 0)};
-	static const std::vector<glm::vec3> WHITE = {glm::vec3(1, 1, 1), glm::vec3(1, 1, 1), glm::vec3(1, 1, 1), glm::vec3(1, 1, 1)};
 
 	struct OctantSide{
 		int direction;
@@ -40,23 +46,85 @@ namespace eve {
 			static constexpr OctantSide Far{-1, 5, {1, 3, 5, 7}};
 
 
-			static const OctantSide reverseSide(const OctantSide side) {
-				if (side.direction == Top.direction)
-					return Down;
-				if (side.direction == Down.direction)
-					return Top;
-				if (side.direction == Left.direction)
-					return Right;
-				if (side.direction == Right.direction)
-					return Left;
-				if (side.direction == Near.direction)
-					return Far;
-				if (side.direction == Far.direction)
-					return Near;
+			// sides are paired in the neighbor order: top/down, left/right, near/far
+			static constexpr int reverse(int neighborDirection) { return neighborDirection ^ 1; }
+	};
 
+	// indexed with OctantSide::neighborDirection, lets the meshing kernels take their side as a template parameter
+	static constexpr OctantSide OCTANT_SIDES[6] = {OctantSides::Top, OctantSides::Down, OctantSides::Left, OctantSides::Right, OctantSides::Near, OctantSides::Far};
+
+	// child centers from their parent center in half child widths, in the Octant::octants order
+	static constexpr int OCTREE_OFFSETS[8][3] = {
+		{-1, -1, -1},	// left		   top		near
+		{-1, -1, 1},	// left		   top		far
+		{1, -1, -1},	// right	   top		near
+		{1, -1, 1},		// right	   top		far
+		{-1, 1, -1},	// left		   bot		near
+		{-1, 1, 1},		// left		   bot		far
+		{1, 1, -1},		// right	   bot		near
+		{1, 1, 1}		// right	   bot		far
+	};
+	static inline glm::vec3 getOctreeOffset(int index) { return glm::vec3(OCTREE_OFFSETS[index][0], OCTREE_OFFSETS[index][1], OCTREE_OFFSETS[index][2]); }
+
+	// octants of a parent touching the given side, as a bit per child index
+	static constexpr int sideMemberMask(int neighborDirection) {
+		int mask = 0;
+		for (int member : OCTANT_SIDES[neighborDirection].members)
+			mask |= 1 << member;
+		return mask;
+	}
+
+	/*
+	* Face quad of each side, indexed with the chunk neighbor order (OctantSide::neighborDirection).
+	* Corners are in half widths from the face center: vertex = octant center + (corner + normal) * width / 2
+	* uv axes are the world axes the uv run along, used to tile the texture over merged faces.
+	*/
+	static constexpr int FACE_NORMALS[6][3] = {{0, -1, 0}, {0, 1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 0, 1}};
+	static constexpr int FACE_CORNERS[6][4][3] = {
+		{{-1, 0, -1}, {1, 0, 1}, {-1, 0, 1}, {1, 0, -1}},	// top
+		{{1, 0, -1}, {-1, 0, 1}, {1, 0, 1}, {-1, 0, -1}},	// down
+		{{0, 1, -1}, {0, -1, 1}, {0, 1, 1}, {0, -1, -1}},	// left
+		{{0, -1, -1}, {0, 1, 1}, {0, -1, 1}, {0, 1, -1}},	// right
+		{{-1, 1, 0}, {1, -1, 0}, {-1, -1, 0}, {1, 1, 0}},	// near
+		{{-1, -1, 0}, {1, 1, 0}, {-1, 1, 0}, {1, -1, 0}}	// far
+	};
+	static constexpr int FACE_UVS[4][2] = {{1, 0}, {0, 1}, {1, 1}, {0, 0}};
+	static constexpr int FACE_UV_AXES[6][2] = {{0, 2}, {0, 2}, {1, 2}, {1, 2}, {0, 1}, {0, 1}};
+	static constexpr uint32_t QUAD_INDICES[6] = {0, 1, 2, 1, 0, 3};
+	// same winding, split along the 2-3 diagonal instead of 0-1
+	static constexpr uint32_t FLIPPED_QUAD_INDICES[6] = {2, 0, 3, 3, 1, 2};
+
+	// the voxel textures are opaque, the translucent pass blends them with a constant opacity
+	static constexpr float TRANSLUCENT_OPACITY = .6f;
+
+	// face ao is 2 bits per corner in the FACE_CORNERS order, the quad is split along its brightest diagonal
+	static inline int getCornerAo(uint8_t ao, int corner) { return (ao >> (corner * 2)) & 3; }
+	static inline const uint32_t *getQuadIndices(uint8_t ao) {
+		return getCornerAo(ao, 0) + getCornerAo(ao, 1) < getCornerAo(ao, 2) + getCornerAo(ao, 3) ? FLIPPED_QUAD_INDICES : QUAD_INDICES;
+	}
+
+	/*
+	* Voxel ids of the one cell thick shell around a chunk (edges and corners included).
+	* It's copied from the neighbor chunks under their own mutex before meshing, the mesher then only reads
+	* its own octree and this buffer, it never walks into another chunk while that one is noised or edited.
+	*/
+	class ChunkHalo {
+		public:
+			static constexpr int PADDED = CHUNK_SIZE + 2;
+			static constexpr uint16_t AIR = EveGreedyMesher::AIR;
+			static constexpr uint16_t UNKNOWN = EveGreedyMesher::UNKNOWN; // no neighbor chunk there
 
-				return Top; // suppress warning (fixme)
-			};
+			// coordinates go from -1 to CHUNK_SIZE, only the cells outside the chunk are filled
+			uint16_t get(glm::ivec3 cell) const { return cells[index(cell)]; }
+			void set(glm::ivec3 cell, uint16_t type) { cells[index(cell)] = type; }
+
+			// unknown cells hide faces but don't darken them
+			bool isOccluder(glm::ivec3 cell) const { uint16_t type = get(cell); return type != AIR && type != UNKNOWN; }
+
+		private:
+			static int index(glm::ivec3 cell) { return (cell.x + 1) + (cell.y + 1) * PADDED + (cell.z + 1) * PADDED * PADDED; }
+
+			std::array<uint16_t, PADDED * PADDED * PADDED> cells;
 	};
 
 	class EveVoxel {
@@ -64,8 +132,12 @@ namespace eve {
 			unsigned int id;
 			std::string name;
 			bool value;
+			// meshed apart and blended after the opaque terrain (water, glass), it doesn't hide the faces behind it nor collide
+			bool translucent;
 
-			EveVoxel(unsigned int i, std::string n, bool v);
+			EveVoxel(unsigned int i, std::string n, bool v, bool t = false);
+
+			bool isOpaque() const { return id != 0 && !translucent; }
 	};
 
 	class Chunk;
@@ -105,12 +177,17 @@ namespace eve {
 			int getChildIndexFromPos(glm::vec3 queryPoint);
 			Octant *getSmallestContainerAt(glm::vec3 coord);
 
-			Octant* transposePathingFromContainerInvDir(const OctantSide side);
+			/*
+			* Neighbor lookups, S is the side neighborDirection (0..5).
+			* They're specialized per side so the side offsets and members are constants,
+			* the results are appended to the caller's vector.
+			* */
+			template <int S> Octant* transposePathingFromContainerInvDir();
 
-			Octant* findNeighborFromEdge(const OctantSide side);
-			std::vector<Octant *> getAllSubOctants(const OctantSide side);
+			template <int S> Octant* findNeighborFromEdge();
+			template <int S> void getAllSubOctants(std::vector<Octant *> &subOctants);
 
-			std::vector<Octant *> getNeighbors(const OctantSide side);
+			template <int S> void getNeighbors(std::vector<Octant *> &neighbors);
 			bool isTopExposed();
 
 			void noiseOctant(Octant *octant);
@@ -120,6 +197,22 @@ namespace eve {
 			Ref<Shape> octantPhysxObject = nullptr;
 	};
 
+	/*
+	* What a remesh reads from the terrain, copied when the job starts: a setting changed meanwhile waits for the next remesh.
+	* Chunk::mesh only goes through it, the octree and the halo, so a chunk is meshed without any terrain, device nor physics (EveMeshBench).
+	* */
+	struct ChunkMeshingSettings {
+		EveTerrainMeshingMode meshingMode = MESHING_CHUNK;
+		EveChunkRenderMode renderMode = CHUNK_RENDER_VERTICES;
+		EveChunkColliderMode colliderMode = COLLIDER_BOXES;
+		bool colliders = true; // Chunk::collidersWanted, the meshers leave the collider shapes out otherwise
+		uint8_t sideMask = 0x3F; // bit n: side n is meshed (EveTerrain::sidesToRemesh)
+		int lod = 0; // greedy meshing only, the octree meshers keep the full resolution
+		int capLayer = -1; // layer the cut view goes through (EveTerrain::getCutLayer), no caps are built without one
+		const std::vector<EveVoxel *> *voxelMap = nullptr; // indexed with the voxel id
+		std::shared_ptr<EveModel> cubeModel; // MESHING_OCTANT draws a cube per octant
+	};
+
 	class EveTerrain;
 	class Chunk {
 		public:
@@ -138,6 +231,8 @@ namespace eve {
 			bool isQueued = false;
 			bool generated = false;
 
+			std::atomic<int> stage{CHUNK_STAGE_CREATED};
+
 			glm::ivec2 countTracker = glm::ivec2(0);
 
 			boost::mutex mutex;
@@ -145,29 +240,205 @@ namespace eve {
 			glm::ivec3 position;
 			EveGameObject::Map chunkObjectMap;
 
-			EveModel::Builder chunkBuilder;
-			std::shared_ptr<EveModel> chunkModel;
-			std::shared_ptr<EveGameObject> chunkObject;
+			/*
+			* The chunk mesh is split in one section per root octant (same index as root->octants),
+			* each one is meshed, uploaded and given its collider on its own so an edit only rebuilds what it touches.
+			* */
+			struct ChunkSection {
+				EveModel::Builder builder;
+				size_t pendingMeshBytes = 0; // builder bytes accounted in EveTerrain::pendingMeshBytes
+				size_t lastFaceCount = 0; // faces of the previous mesh, the next one reserves that much
+
+				std::shared_ptr<EveModel> model;
+				EveGameObject::id_t objectId = 0;
+				bool hasObject = false;
+
+				BodyID physxObject;
+				MutableCompoundShapeSettings shapeSettings;
+			};
+			static constexpr int SECTION_COUNT = 8;
+			static constexpr int SECTION_SIZE = CHUNK_SIZE / 2;
+			static constexpr uint8_t ALL_SECTIONS = 0xFF;
+
+			ChunkSection sections[SECTION_COUNT];
+			std::atomic<uint8_t> dirtySections{0}; // bit n: section n waits for a remesh, taken by the next meshing job
+			uint8_t uploadSections = 0; // bit n: section n got meshed and waits for integrateChunk (chunk mutex)
+
+			/*
+			* Distant chunks are meshed from a coarser octree depth: at lod n the octants of width 1 << n are meshed
+			* as whole cells, solid when most of their children are. Set by the terrain from the camera distance,
+			* read once by the next meshing job (greedy meshing only, the octree meshers keep the full resolution).
+			* */
+			static constexpr int MAX_LOD = 3;
+			std::atomic<int> lod{0};
+
+			/*
+			* Caps of the cut view (EveTerrain::cutEnabled): the top faces of the solid cells under a solid cell,
+			* only for the layer the view is cut at so the cut shows as solid. The remeshes build them for the layer
+			* of the moment, the terrain asks for new ones (updateCaps) when the cut moves to another layer of the chunk.
+			* Uncut chunks have none.
+			* */
+			EveModel::Builder capBuilder; // layerOffsets has CHUNK_SIZE + 1 entries, only capLayer's range isn't empty
+			std::shared_ptr<EveModel> capModel;
+			int capLayer = -1; // layer of capBuilder, then of capModel (chunk mutex)
+			bool uploadCaps = false; // capBuilder waits for integrateChunk (chunk mutex)
+			// caps for the current cut layer without remeshing, handed to the integration queue (background job)
+			void updateCaps();
 
-			BodyID chunkPhysxObject;
-			MutableCompoundShapeSettings chunkShapeSettings;
+			/*
+			* Faces of the translucent voxels, meshed for the whole chunk with every remesh and drawn after the opaque terrain.
+			* They're kept on the cpu: blending needs them back to front, so the terrain sorts them again and rebuilds
+			* translucentModel whenever the eye crosses one of the chunk planes (getVisibleSides changes), in between
+			* the order of the faces of a chunk hardly changes. The chunk the eye is in has every side visible,
+			* it's sorted again once the eye moved far enough instead. The sorts go through the integration queue.
+			* */
+			std::vector<EveGreedyMesher::Quad> translucentQuads;
+			std::shared_ptr<EveModel> translucentModel;
+			uint8_t translucentSides = 0; // visible sides the model was sorted for
+			glm::vec3 translucentEye{0.f}; // eye the model was sorted from
+			bool uploadTranslucent = false; // translucentQuads wait for integrateChunk (chunk mutex)
+			bool resortTranslucent = false; // the model waits in the integration queue to be sorted again (chunk mutex)
+
+			// translucentQuads back to front from the eye into the builder (chunk mutex held)
+			void sortTranslucent(glm::vec3 eye, EveModel::Builder &builder, bool faceRecords);
+
+			/*
+			* Collider of the whole chunk with COLLIDER_VOXEL_SHAPE: filled from the octree by the first remesh and kept
+			* in sync by setVoxel, the remeshes never rebuild it (the section compounds stay empty).
+			* */
+			Ref<EveVoxelShape> voxelShape;
+			BodyID voxelBody;
+
+			// a dynamic body is in range (EveTerrain::updateChunkColliders, and whenever the chunk goes to meshing), the meshing jobs leave the colliders out otherwise
+			std::atomic<bool> collidersWanted{false};
+			// builds or releases the colliders after collidersWanted changed, without remeshing (background job)
+			void updateColliders();
 
 			Chunk(Octant *r, glm::vec3 pos, EveTerrain *terrain);
 
 			~Chunk();
 
 			void remesh(Octant *octant);
-
-			void createFace(Octant *octant, std::vector<glm::vec3> colors, const OctantSide side);
-			void remesh2rec(Octant *octant, bool rec = true);
+			// cube objects of the opaque octants under octant, into chunkObjectMap (MESHING_OCTANT)
+			void addCubes(Octant *octant, const std::shared_ptr<EveModel> &cubeModel);
+
+			// localOffset is the octant center relative to the root, the chunk mutex is held by the caller
+			template <int S> void createFace(Octant *octant, glm::vec3 localOffset, bool marked);
+			template <int S> uint8_t getFaceAo(glm::ivec3 min, int width);
+			template <int S> void remeshSide(Octant *octant, glm::vec3 localOffset, std::vector<Octant *> &neighbors);
+			void remesh2rec(Octant *octant, glm::vec3 localOffset, bool rec = true);
+			// both take the chunk dirtySections, a chunk without dirty section is fully remeshed
 			void remesh2(Chunk *chunk);
+			void remeshGreedy(Chunk *chunk);
+
+			/*
+			* The meshing part of a remesh, without the pipeline around it (terrain queues, physics bodies, upload):
+			* the section builders and collider shapes of sectionMask, the caps and the translucent faces, from the octree and the halo.
+			* The meshing jobs run it between beginRemesh and finishRemesh, EveMeshBench alone on chunks without terrain.
+			* */
+			void mesh(uint8_t sectionMask, const ChunkHalo &halo, const ChunkMeshingSettings &settings);
 
 			void noise(Octant *octant);
 
+			// voxel id the octant is meshed with when it's collapsed by the lod, uniform octants and leaves keep their own
+			static uint16_t getLodType(Octant *octant);
+
+			void releasePendingMesh();
+			void releasePendingMesh(ChunkSection &section);
+
+			static int getSectionAt(glm::ivec3 cell) { return (cell.x >= SECTION_SIZE ? 2 : 0) + (cell.y >= SECTION_SIZE ? 4 : 0) + (cell.z >= SECTION_SIZE ? 1 : 0); }
+			static glm::ivec3 getSectionMin(int section) { return glm::ivec3(section & 2 ? SECTION_SIZE : 0, section & 4 ? SECTION_SIZE : 0, section & 1 ? SECTION_SIZE : 0); }
+			// sections with cells on the given side of the chunk (chunk neighbor order)
+			static uint8_t getSideSections(int side) {
+				int bit = side <= 1 ? 4 : side <= 3 ? 2 : 1;
+				uint8_t mask = 0;
+				for (int i = 0; i < SECTION_COUNT; i++)
+					if (bool(i & bit) != EveGreedyMesher::isNegativeSide(side))
+						mask |= 1 << i;
+				return mask;
+			}
+
+			// sets the leaf voxel of the cell (chunk corner space), uniform octants on the way are split
+			void setVoxel(glm::ivec3 cell, EveVoxel *voxel);
+
+			// wakes up every coroutine waiting for this stage (or an earlier one)
+			void setStage(ChunkStage newStage);
+
+			/*
+			* co_await chunk->reached(CHUNK_STAGE_MESHED): resumes on the given lane once the chunk got there.
+			* Returns false when the chunk got destroyed first, the coroutine must not touch it anymore then.
+			*/
+			struct StageAwaiter {
+				Chunk &chunk;
+				ChunkStage target;
+				EveSchedulerLane lane;
+				bool result = true;
+
+				bool await_ready() const { return chunk.stage >= target; }
+				bool await_suspend(std::coroutine_handle<> handle);
+				bool await_resume() const noexcept { return result; }
+			};
+			StageAwaiter reached(ChunkStage target, EveSchedulerLane lane = LANE_MAIN) { return StageAwaiter{*this, target, lane}; }
+
 			bool isCoordInChunk(glm::vec3 coord);
 			Octant *getSmallestContainerOf(glm::vec3 coord);
 
+			// chunk at the given offset (-1, 0 or 1 on each axis), edges and corners go through two or three neighbors
+			Chunk *getNeighborChunk(glm::ivec3 direction);
+
+			// sides (bit n: chunk neighbor order) whose faces can face the eye, from the chunk bounds
+			uint8_t getVisibleSides(glm::vec3 eye) const;
+
+			// copies the shell around the chunk, each neighbor is locked while it's read (never call it with the chunk mutex held)
+			void snapshotHalo(ChunkHalo &halo);
+
 			EveTerrain *eveTerrain;
 		private:
+			// the terrain settings for a remesh in the given mode
+			ChunkMeshingSettings getMeshingSettings(EveTerrainMeshingMode meshingMode);
+			// remesh2 and remeshGreedy: mesh between the terrain hand-offs
+			void remeshSections(EveTerrainMeshingMode meshingMode);
+			// shared by the meshing modes: hides the chunk and drops the colliders before meshing, colliders bodies and hand-off to the terrain after
+			uint8_t beginRemesh(const ChunkMeshingSettings &settings);
+			// empty builders and collider shapes for the sections about to be meshed
+			void resetSections(uint8_t sectionMask);
+			// the octree meshed octant by octant into the sections (chunk mutex held)
+			void meshOctree(uint8_t sectionMask);
+			// merged faces of the filled mesher into the sections
+			void meshGreedy(EveGreedyMesher &mesher, uint8_t sectionMask);
+			// the octree at the settings lod and the halo in the mesher grid (chunk mutex held)
+			void fillMesher(EveGreedyMesher &mesher, const ChunkHalo &halo, const ChunkMeshingSettings &settings);
+			// cut caps of one layer from a filled mesher (none for -1), handed to capBuilder
+			void buildCaps(EveGreedyMesher &mesher, int layer, bool faceRecords);
+			// translucent faces of the whole chunk from a filled mesher, handed to translucentQuads
+			void buildTranslucent(EveGreedyMesher &mesher);
+			void finishRemesh(uint8_t sectionMask, const ChunkMeshingSettings &settings);
+			// COLLIDER_MERGED_BOXES: the opaque cells of each section merged in boxes, into its compound (takes the chunk mutex)
+			void buildMergedColliders(uint8_t sectionMask);
+			// voxelShape from the octree and its static body (takes the chunk mutex)
+			void createVoxelBody();
+			void destroyVoxelBody();
+			// static bodies of the section compounds
+			void createSectionBodies(uint8_t sectionMask);
+			void removeSectionBodies(uint8_t sectionMask);
+
+			// section the running meshing job writes to, the mesh builder and the colliders go there
+			int meshingSection = 0;
+			// neighbors snapshot of the running meshing job
+			const ChunkHalo *meshingHalo = nullptr;
+			// octree and halo of the running octree meshing job as a flat grid, the face ao is sampled there
+			const EveGreedyMesher *meshingGrid = nullptr;
+			// settings of the running meshing job, the meshers only add the octant boxes with COLLIDER_BOXES
+			const ChunkMeshingSettings *meshingSettings = nullptr;
+
+			struct StageWaiter {
+				ChunkStage target;
+				EveSchedulerLane lane;
+				std::coroutine_handle<> handle;
+				bool *reached; // StageAwaiter::result, lives in the suspended coroutine frame
+			};
+
+			boost::mutex stageMutex;
+			std::vector<StageWaiter> stageWaiters;
 	};
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <glm/gtx/hash.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <string.h>
 #include <iostream>
@@ -268,6 +269,25 @@ namespace eve
 		ImGui::Text("candidates: %zu ", eveTerrain.remeshingCandidates.size()); ImGui::SameLine();
 		ImGui::Text("processing: %zu ", eveTerrain.remeshingProcessing.size()); ImGui::SameLine();
 		ImGui::Text("processed: %zu ", eveTerrain.remeshingProcessed.size());
+		ImGui::Text("waiting for upload: %zu ", eveTerrain.integrationQueue.size());
+
+		ImGui::SeparatorText("backpressure");
+		{
+			boost::lock_guard<boost::mutex> lock(eveTerrain.mutex);
+			ImGui::Text("in-flight jobs: %zu / %d ", eveTerrain.getInFlightJobs(), eveTerrain.maxInFlightJobs); ImGui::SameLine();
+			ImGui::Text("meshing backlog: %zu ", eveTerrain.getMeshingBacklog());
+			ImGui::Text("noising: %s  meshing: %s",
+				eveTerrain.isNoisingSaturated() ? "held back" : "flowing",
+				eveTerrain.isMeshingSaturated() ? "held back" : "flowing");
+		}
+		ImGui::Text("pending mesh data: %.2f / %.2f MB ",
+			float(eveTerrain.pendingMeshBytes) / (1024 * 1024),
+			float(eveTerrain.maxPendingMeshBytes) / (1024 * 1024));
+		ImGui::Text("scheduler background: %zu queued, %u running (max %u) ",
+			eveTerrain.eveScheduler.getQueuedCount(LANE_BACKGROUND),
+			eveTerrain.eveScheduler.getRunningCount(LANE_BACKGROUND),
+			eveTerrain.eveScheduler.getBackgroundConcurrency());
+		ImGui::Text("physics step: %.2f ms (fixed %.0f Hz) ", eveTerrain.evePhysx.lastStepMs.load(), 1.f / EvePhysx::FIXED_STEP);
 
 		ImGui::Separator();
 		ImGui::Text("chunk map: %zu ", eveTerrain.chunkMap.size());
@@ -281,9 +301,34 @@ namespace eve
 
 			static int meshingMode = 1;
 			ImGui::RadioButton("octant", &meshingMode, 0); ImGui::SameLine();
-			ImGui::RadioButton("chunk", &meshingMode, 1);
+			ImGui::RadioButton("chunk", &meshingMode, 1); ImGui::SameLine();
+			ImGui::RadioButton("greedy", &meshingMode, 2);
 			if (meshingMode == 0) eveTerrain.meshingMode = MESHING_OCTANT;
 			else if (meshingMode == 1) eveTerrain.meshingMode = MESHING_CHUNK;
+			else if (meshingMode == 2) eveTerrain.meshingMode = MESHING_GREEDY;
+
+			static int chunkRenderMode = 0;
+			ImGui::RadioButton("vertices", &chunkRenderMode, 0); ImGui::SameLine();
+			ImGui::RadioButton("face records", &chunkRenderMode, 1);
+			if (chunkRenderMode == 0) eveTerrain.chunkRenderMode = CHUNK_RENDER_VERTICES;
+			else if (chunkRenderMode == 1) eveTerrain.chunkRenderMode = CHUNK_RENDER_FACES;
+
+			static int colliderMode = 2;
+			ImGui::RadioButton("box colliders", &colliderMode, 0); ImGui::SameLine();
+			ImGui::RadioButton("merged boxes", &colliderMode, 1); ImGui::SameLine();
+			ImGui::RadioButton("voxel shape", &colliderMode, 2);
+			if (colliderMode == 0) eveTerrain.colliderMode = COLLIDER_BOXES;
+			else if (colliderMode == 1) eveTerrain.colliderMode = COLLIDER_MERGED_BOXES;
+			else if (colliderMode == 2) eveTerrain.colliderMode = COLLIDER_VOXEL_SHAPE;
+
+			ImGui::Checkbox("lazy colliders", &eveTerrain.lazyColliders); ImGui::SameLine();
+			ImGui::SliderFloat("collider margin", &eveTerrain.colliderMargin, 0.f, 32.f);
+
+			ImGui::Checkbox("cut view", &eveTerrain.cutEnabled); ImGui::SameLine();
+			ImGui::InputInt("cut level (mouse wheel)", &eveTerrain.playerCurrentLevel);
+
+			ImGui::Checkbox("lod", &eveTerrain.lodEnabled); ImGui::SameLine();
+			ImGui::SliderFloat3("lod distances", eveTerrain.lodDistances, 16.f, 512.f);
 		}
 		
 		if (ImGui::CollapsingHeader("FPS")) {
@@ -365,6 +410,13 @@ namespace eve
 				}
 
 
+				ImGui::SliderFloat("upload budget (ms/frame)", &frameInfo.terrain.integrationBudgetMs, 0.5f, 16.f);
+				ImGui::InputInt("max in-flight jobs", &frameInfo.terrain.maxInFlightJobs);
+				static int pendingMeshMB = int(frameInfo.terrain.maxPendingMeshBytes / (1024 * 1024));
+				if (ImGui::InputInt("max pending mesh (MB)", &pendingMeshMB))
+					frameInfo.terrain.maxPendingMeshBytes = size_t(std::max(1, pendingMeshMB)) * 1024 * 1024;
+				frameInfo.terrain.maxInFlightJobs = std::max(1, frameInfo.terrain.maxInFlightJobs);
+
 				ImGui::Text("Chunks to generate:");
 				ImGui::InputInt2("x", glm::value_ptr(frameInfo.terrain.xRange));
 				ImGui::InputInt2("y", glm::value_ptr(frameInfo.terrain.yRange));
@@ -33,6 +33,7 @@ namespace eve
 
 	struct GravityComponent {
 		JPH::BodyID bodyID;
+		uint32_t stateIndex = 0; // in the states published by EvePhysx
 		glm::vec3 direction;
 		float force;
 		bool grounded;
@@ -0,0 +1,271 @@
+#include "eve_greedy_mesher.hpp"
+
+#include <easy/profiler.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace eve {
+
+	void EveGreedyMesher::fill(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, uint16_t type) {
+		for (int z = minZ; z < maxZ; z++)
+			for (int y = minY; y < maxY; y++)
+				for (int x = minX; x < maxX; x++)
+					voxels[index(x, y, z)] = type;
+		columnsDirty = true;
+	}
+
+	uint8_t EveGreedyMesher::getFaceAo(const int cell[3], int axis, int uAxis, int vAxis, int normal) const {
+		int front[3] = {cell[0], cell[1], cell[2]};
+		front[axis] += normal;
+
+		uint8_t ao = 0;
+		for (int corner = 0; corner < 4; corner++) {
+			int du = corner & 1 ? 1 : -1;
+			int dv = corner & 2 ? 1 : -1;
+
+			int side1[3] = {front[0], front[1], front[2]};
+			side1[uAxis] += du;
+			int side2[3] = {front[0], front[1], front[2]};
+			side2[vAxis] += dv;
+			int diagonal[3] = {side1[0], side1[1], side1[2]};
+			diagonal[vAxis] += dv;
+
+			int value = getVertexAo(
+				isOccluder(side1[0], side1[1], side1[2]),
+				isOccluder(side2[0], side2[1], side2[2]),
+				isOccluder(diagonal[0], diagonal[1], diagonal[2]));
+			ao |= value << (corner * 2);
+		}
+		return ao;
+	}
+
+	size_t EveGreedyMesher::getTypeSlot(uint32_t key) {
+		size_t mask = slotTable.size() - 1;
+		uint32_t hash = key * 0x9E3779B1u;
+		for (size_t i = (hash ^ (hash >> 16)) & mask;; i = (i + 1) & mask) {
+			SlotEntry &entry = slotTable[i];
+			if (entry.stamp == slotStamp) {
+				if (entry.key == key)
+					return entry.slot;
+				continue;
+			}
+
+			if (typeCount == typePlanes.size()) {
+				typeKeys.push_back(key);
+				typePlanes.emplace_back();
+			}
+			typeKeys[typeCount] = key;
+			for (Plane &plane : typePlanes[typeCount])
+				plane.fill(0);
+			entry = {slotStamp, key, static_cast<uint32_t>(typeCount)};
+
+			// kept under half full so the probes stay short, the live keys go to a table twice as big
+			if (++typeCount * 2 > slotTable.size())
+				growTypeSlots();
+			return typeCount - 1;
+		}
+	}
+
+	void EveGreedyMesher::growTypeSlots() {
+		slotTable.assign(slotTable.size() * 2, SlotEntry{});
+		slotStamp = 1;
+
+		size_t mask = slotTable.size() - 1;
+		for (size_t slot = 0; slot < typeCount; slot++) {
+			uint32_t hash = typeKeys[slot] * 0x9E3779B1u;
+			size_t i = (hash ^ (hash >> 16)) & mask;
+			while (slotTable[i].stamp == slotStamp)
+				i = (i + 1) & mask;
+			slotTable[i] = {slotStamp, typeKeys[slot], static_cast<uint32_t>(slot)};
+		}
+	}
+
+	void EveGreedyMesher::resetTypeSlots() {
+		typeCount = 0;
+		// a wrapped stamp would bring stale entries back to life
+		if (++slotStamp == 0) {
+			slotTable.assign(slotTable.size(), SlotEntry{});
+			slotStamp = 1;
+		}
+	}
+
+	void EveGreedyMesher::setTranslucent(uint16_t type, bool translucent) {
+		if (type >= translucentTypes.size()) {
+			if (!translucent)
+				return;
+			translucentTypes.resize(type + 1, 0);
+		}
+		// the opaque columns depend on it
+		if (translucentTypes[type] != translucent)
+			columnsDirty = true;
+		translucentTypes[type] = translucent;
+	}
+
+	void EveGreedyMesher::buildColumns(Columns &out, uint16_t type) {
+		out.fill(0);
+		for (int z = 0; z < PADDED; z++) {
+			for (int y = 0; y < PADDED; y++) {
+				for (int x = 0; x < PADDED; x++) {
+					uint16_t cell = voxels[x + y * PADDED + z * PADDED * PADDED];
+					if (type == AIR ? !isOpaque(cell) : cell != type)
+						continue;
+					out[0 * PADDED * PADDED + z * PADDED + y] |= 1ull << x;	// x axis: u = y, v = z
+					out[1 * PADDED * PADDED + x * PADDED + z] |= 1ull << y;	// y axis: u = z, v = x
+					out[2 * PADDED * PADDED + y * PADDED + x] |= 1ull << z;	// z axis: u = x, v = y
+				}
+			}
+		}
+	}
+
+	void EveGreedyMesher::updateColumns() {
+		if (!columnsDirty)
+			return;
+		buildColumns(columns, AIR);
+		columnsDirty = false;
+	}
+
+	void EveGreedyMesher::addFaces(const Columns &cells, bool translucent, uint8_t sideMask, const int regionMin[3], int size) {
+		for (int side = 0; side < 6; side++) {
+			if (!(sideMask & (1 << side)))
+				continue;
+
+			int axis = getSideAxis(side);
+			int uAxis, vAxis;
+			getPlaneAxes(axis, uAxis, vAxis);
+
+			// cells of the region along the axis, the padding is never part of it
+			uint64_t insideMask = ((1ull << size) - 1) << regionMin[axis];
+
+			for (int v = regionMin[vAxis]; v < regionMin[vAxis] + size; v++) {
+				for (int u = regionMin[uAxis]; u < regionMin[uAxis] + size; u++) {
+					size_t columnIndex = axis * PADDED * PADDED + (v + 1) * PADDED + (u + 1);
+					uint64_t column = cells[columnIndex];
+					uint64_t blocking = translucent ? column | columns[columnIndex] : column;
+					// cells whose previous (or next) cell along the axis doesn't block them, minus the padding
+					uint64_t faces = isNegativeSide(side) ? column & ~(blocking << 1) : column & ~(blocking >> 1);
+					faces = (faces >> 1) & insideMask;
+
+					while (faces) {
+						int slice = std::countr_zero(faces);
+						faces &= faces - 1;
+
+						int cell[3];
+						cell[axis] = slice;
+						cell[uAxis] = u;
+						cell[vAxis] = v;
+						uint16_t type = get(cell[0], cell[1], cell[2]);
+						uint8_t ao = translucent ? 0xFF : getFaceAo(cell, axis, uAxis, vAxis, isNegativeSide(side) ? -1 : 1);
+
+						typePlanes[getTypeSlot(type | uint32_t(ao) << 16)][side * SIZE + slice][v] |= 1ull << u;
+					}
+				}
+			}
+		}
+	}
+
+	void EveGreedyMesher::mesh(std::vector<Quad> &quads, uint8_t sideMask, int minX, int minY, int minZ, int size) {
+		EASY_FUNCTION(profiler::colors::Blue100);
+		const int regionMin[3] = {minX, minY, minZ};
+
+		// exposed faces of the opaque cells, sorted by type and ao into the side/slice planes
+		updateColumns();
+		resetTypeSlots();
+		addFaces(columns, false, sideMask, regionMin, size);
+
+		// maximal rectangles, the planes are left empty for the next call
+		mergePlanes(quads, sideMask);
+	}
+
+	void EveGreedyMesher::meshTranslucent(std::vector<Quad> &quads, uint8_t sideMask, int minX, int minY, int minZ, int size) {
+		EASY_FUNCTION(profiler::colors::Blue100);
+		const int regionMin[3] = {minX, minY, minZ};
+
+		// most chunks hold no translucent cell at all
+		presentTranslucentTypes.clear();
+		for (uint16_t type : voxels)
+			if (isTranslucent(type) && std::find(presentTranslucentTypes.begin(), presentTranslucentTypes.end(), type) == presentTranslucentTypes.end())
+				presentTranslucentTypes.push_back(type);
+		if (presentTranslucentTypes.empty())
+			return;
+
+		// one pass per type, two touching translucent types (water in glass) both keep their faces
+		updateColumns();
+		resetTypeSlots();
+		for (uint16_t type : presentTranslucentTypes) {
+			buildColumns(translucentColumns, type);
+			addFaces(translucentColumns, true, sideMask, regionMin, size);
+		}
+
+		mergePlanes(quads, sideMask);
+	}
+
+	void EveGreedyMesher::meshCut(std::vector<Quad> &quads, int y) {
+		EASY_FUNCTION(profiler::colors::Blue100);
+		constexpr int SIDE = 0; // top
+
+		// solid cells under a solid cell, their top face only shows once the layers above are cut away
+		// (the ones under air or a translucent cell already have a top face)
+		resetTypeSlots();
+		for (int x = 0; x < SIZE; x++) {
+			for (int z = 0; z < SIZE; z++) {
+				if (!isOccluder(x, y, z) || !isOpaque(get(x, y - 1, z)))
+					continue;
+				uint16_t type = get(x, y, z);
+				// top plane: u = z, v = x, flat lit like an unoccluded face
+				typePlanes[getTypeSlot(type | 0xFFu << 16)][SIDE * SIZE + y][x] |= 1ull << z;
+			}
+		}
+
+		for (size_t slot = 0; slot < typeCount; slot++)
+			mergePlane(quads, typePlanes[slot][SIDE * SIZE + y], SIDE, y, typeKeys[slot]);
+	}
+
+	void EveGreedyMesher::mergePlanes(std::vector<Quad> &quads, uint8_t sideMask) {
+		for (size_t slot = 0; slot < typeCount; slot++) {
+			for (int side = 0; side < 6; side++) {
+				if (!(sideMask & (1 << side)))
+					continue;
+				for (int slice = 0; slice < SIZE; slice++)
+					mergePlane(quads, typePlanes[slot][side * SIZE + slice], side, slice, typeKeys[slot]);
+			}
+		}
+	}
+
+	void EveGreedyMesher::mergePlane(std::vector<Quad> &quads, Plane &rows, int side, int slice, uint32_t key) {
+		int axis = getSideAxis(side);
+		int uAxis, vAxis;
+		getPlaneAxes(axis, uAxis, vAxis);
+
+		for (int v = 0; v < SIZE; v++) {
+			while (rows[v]) {
+				int u = std::countr_zero(rows[v]);
+				int width = std::countr_one(rows[v] >> u);
+				uint64_t run = ((1ull << width) - 1) << u;
+				rows[v] &= ~run;
+
+				int height = 1;
+				while (v + height < SIZE && (rows[v + height] & run) == run) {
+					rows[v + height] &= ~run;
+					height++;
+				}
+
+				int cell[3];
+				cell[axis] = slice;
+				cell[uAxis] = u;
+				cell[vAxis] = v;
+
+				Quad quad{};
+				quad.side = static_cast<uint8_t>(side);
+				quad.x = static_cast<uint8_t>(cell[0]);
+				quad.y = static_cast<uint8_t>(cell[1]);
+				quad.z = static_cast<uint8_t>(cell[2]);
+				quad.width = static_cast<uint8_t>(width);
+				quad.height = static_cast<uint8_t>(height);
+				quad.type = static_cast<uint16_t>(key & 0xFFFF);
+				quad.ao = static_cast<uint8_t>(key >> 16);
+				quads.push_back(quad);
+			}
+		}
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eve {
+	/*
+	* Binary greedy mesher.
+	* Works on a padded voxel grid (the chunk plus one layer of its neighbors cells) where every column is a bitmask:
+	*	- exposed faces of a whole column are found with a shift and a mask
+	*	- faces are sorted per side, slice, voxel type and ambient occlusion into 2D planes of row bitmasks
+	*	- each plane is merged into maximal rectangles, a row run is the trailing zeros count of the row,
+	*	  it grows downward as long as the next rows contain the same run
+	* Translucent types (water, glass) are meshed apart with meshTranslucent, they neither hide nor darken the opaque faces behind them.
+	* It doesn't know anything about octants nor vertices so it can be benchmarked alone.
+	*/
+	class EveGreedyMesher {
+		public:
+			static constexpr int SIZE = 16;
+			static constexpr int PADDED = SIZE + 2;
+			static_assert(PADDED <= 64, "a padded column has to fit in a 64 bit word");
+
+			static constexpr uint16_t AIR = 0;
+			static constexpr uint16_t UNKNOWN = 0xFFFF; // solid for face culling but never meshed (missing neighbor)
+
+			/*
+			* One merged face, side follows the chunk neighbor order:
+			* 0 top (-y), 1 down (+y), 2 left (-x), 3 right (+x), 4 near (-z), 5 far (+z)
+			* width runs along the first plane axis of the side, height along the second one (see getPlaneAxes)
+			* ao holds the 4 corners (2 bits each, 3 is unoccluded) in the plane order: bit 0 set for the max u corner, bit 1 for the max v one
+			*/
+			struct Quad {
+				uint8_t side;
+				uint8_t x, y, z; // min cell of the rectangle
+				uint8_t width;
+				uint8_t height;
+				uint16_t type;
+				uint8_t ao;
+			};
+
+			EveGreedyMesher() { clear(); }
+
+			// every cell back to air, padding included
+			void clear() { voxels.fill(AIR); columnsDirty = true; }
+
+			// coordinates go from -1 to SIZE, -1 and SIZE are the neighbor chunks cells
+			void set(int x, int y, int z, uint16_t type) { voxels[index(x, y, z)] = type; columnsDirty = true; }
+			uint16_t get(int x, int y, int z) const { return voxels[index(x, y, z)]; }
+			// opaque and known, the cells that darken the faces next to them
+			bool isOccluder(int x, int y, int z) const { uint16_t type = get(x, y, z); return isOpaque(type) && type != UNKNOWN; }
+			void fill(int minX, int minY, int minZ, int maxX, int maxY, int maxZ, uint16_t type); // max excluded
+
+			// appends the merged faces of the sides enabled in sideMask (bit n = side n)
+			void mesh(std::vector<Quad> &quads, uint8_t sideMask = 0x3F) { mesh(quads, sideMask, 0, 0, 0, SIZE); }
+			// same, only for the faces of the cells in [min, min + size), merged faces never cross the region
+			// (the column bitmasks are built once per fill, meshing several regions of the same grid doesn't rebuild them)
+			void mesh(std::vector<Quad> &quads, uint8_t sideMask, int minX, int minY, int minZ, int size);
+			// appends the merged top faces of the layer y cells hidden under a solid cell, the cap of a view cut at y
+			void meshCut(std::vector<Quad> &quads, int y);
+
+			// kept between fills, every type is opaque until told otherwise
+			void setTranslucent(uint16_t type, bool translucent);
+			bool isTranslucent(uint16_t type) const { return type < translucentTypes.size() && translucentTypes[type]; }
+			// appends the merged faces of the translucent cells, a face shows where its neighbor is neither opaque nor of the same type
+			// (flat lit, ao is 0xFF), the opaque faces come from mesh()
+			void meshTranslucent(std::vector<Quad> &quads, uint8_t sideMask = 0x3F) { meshTranslucent(quads, sideMask, 0, 0, 0, SIZE); }
+			void meshTranslucent(std::vector<Quad> &quads, uint8_t sideMask, int minX, int minY, int minZ, int size);
+
+			static constexpr int getSideAxis(int side) { return side <= 1 ? 1 : side <= 3 ? 0 : 2; }
+			static constexpr bool isNegativeSide(int side) { return side % 2 == 0; }
+			static void getPlaneAxes(int axis, int &u, int &v) { u = (axis + 1) % 3; v = (axis + 2) % 3; }
+
+			// classic vertex ao from the 3 cells touching the corner in front of the face, 0 is fully occluded
+			static constexpr int getVertexAo(bool side1, bool side2, bool corner) { return side1 && side2 ? 0 : 3 - (side1 + side2 + corner); }
+
+		private:
+			using Plane = std::array<uint64_t, SIZE>; // one row bitmask per v, bit u
+			using SidePlanes = std::array<Plane, 6 * SIZE>; // [side * SIZE + slice]
+			using Columns = std::array<uint64_t, 3 * PADDED * PADDED>; // [axis][v][u], bit n = padded cell n along the axis
+
+			static int index(int x, int y, int z) { return (x + 1) + (y + 1) * PADDED + (z + 1) * PADDED * PADDED; }
+
+			// unknown cells are opaque, they hide faces but don't darken them
+			bool isOpaque(uint16_t type) const { return type != AIR && !isTranslucent(type); }
+			uint8_t getFaceAo(const int cell[3], int axis, int uAxis, int vAxis, int normal) const;
+
+			// column bitmasks of the opaque cells (type AIR) or of the cells of one translucent type, padding included
+			void buildColumns(Columns &out, uint16_t type);
+			// opaque columns of the current grid, rebuilt only when a cell changed since the last build
+			void updateColumns();
+			// sorts the exposed faces of the cells into the planes, translucent cells are also hidden by the opaque columns
+			void addFaces(const Columns &cells, bool translucent, uint8_t sideMask, const int regionMin[3], int size);
+
+			// faces are only merged with faces of the same type and ao, key = type | ao << 16
+			size_t getTypeSlot(uint32_t key);
+			// forgets every slot, the planes are reused by the next keys
+			void resetTypeSlots();
+			void growTypeSlots();
+			// appends the maximal rectangles of the plane and clears it
+			void mergePlane(std::vector<Quad> &quads, Plane &rows, int side, int slice, uint32_t key);
+			// same for every plane filled since the last typeCount reset
+			void mergePlanes(std::vector<Quad> &quads, uint8_t sideMask);
+
+			std::array<uint16_t, PADDED * PADDED * PADDED> voxels;
+			Columns columns; // opaque cells
+			bool columnsDirty = true;
+			Columns translucentColumns; // cells of the translucent type being meshed
+
+			std::vector<uint8_t> translucentTypes; // indexed with the type
+			std::vector<uint16_t> presentTranslucentTypes;
+
+			// kept between calls so meshing doesn't allocate once warmed up
+			std::vector<uint32_t> typeKeys;
+			std::vector<SidePlanes> typePlanes;
+			size_t typeCount = 0;
+
+			// open addressing key -> slot table, entries of an older stamp are empty (a reset is one increment)
+			struct SlotEntry {
+				uint32_t stamp = 0;
+				uint32_t key = 0;
+				uint32_t slot = 0;
+			};
+			std::vector<SlotEntry> slotTable = std::vector<SlotEntry>(256);
+			uint32_t slotStamp = 1;
+	};
+}
@@ -7,9 +7,11 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <string.h>
 #include <iostream>
+#include <sstream>
 #include <unordered_map>
 
 #ifndef ENGINE_DIR
@@ -32,14 +34,29 @@ namespace std
 
 namespace eve
 {
-	EveModel::EveModel(EveDevice &device, const EveModel::Builder &builder) : eveDevice{device}
+	EveModel::EveModel(EveDevice &device, const EveModel::Builder &builder, bool asyncUpload) : eveDevice{device}, asyncUpload{asyncUpload}
 	{
-		createVertexBuffers(builder.vertices);
+		groupedBySide = builder.groupedBySide;
+		sideOffsets = builder.sideOffsets;
+		layerOffsets = builder.layerOffsets;
+
+		if (!builder.faces.empty())
+		{
+			createFaceBuffer(builder.faces);
+			return;
+		}
+
+		chunkVertices = !builder.chunkVertices.empty();
+		if (chunkVertices)
+			createVertexBuffers(builder.chunkVertices.data(), sizeof(ChunkVertex), static_cast<uint32_t>(builder.chunkVertices.size()));
+		else
+			createVertexBuffers(builder.vertices.data(), sizeof(Vertex), static_cast<uint32_t>(builder.vertices.size()));
 		createIndexBuffers(builder.indices);
 	}
 
 	EveModel::~EveModel()
 	{
+		releaseUploads();
 	}
 
 	std::unique_ptr<EveModel> EveModel::createModelFromFile(EveDevice &device, const std::string &filepath, glm::vec3 color)
@@ -60,22 +77,61 @@ namespace eve
 		return std::make_unique<EveModel>(device, builder);
 	}
 
-	void EveModel::createVertexBuffers(const std::vector<Vertex> &vertices)
+	Task<std::shared_ptr<EveModel>> EveModel::loadModelAsync(EveDevice &device, EveScheduler &scheduler, std::string filepath, glm::vec3 color)
+	{
+		// read and parsed on the background lane, the buffers are created back on the main thread
+		std::vector<char> bytes = co_await readFileAsync(scheduler, filepath);
+		std::istringstream stream(std::string(bytes.begin(), bytes.end()));
+		Builder builder{};
+		builder.loadModel(stream, color);
+
+		co_await resumeOn(scheduler, LANE_MAIN);
+		co_return std::make_shared<EveModel>(device, builder);
+	}
+
+	Task<> EveModel::finishUpload(std::shared_ptr<EveModel> model, EveScheduler &scheduler)
+	{
+		// the model is kept alive by the coroutine until its copies are done
+		for (PendingUpload &upload : model->pendingUploads)
+			co_await fenceSignaled(scheduler, model->eveDevice.device(), upload.fence);
+		model->releaseUploads();
+	}
+
+	void EveModel::releaseUploads()
 	{
-		vertexCount = static_cast<uint32_t>(vertices.size());
+		for (PendingUpload &upload : pendingUploads)
+			eveDevice.releaseUpload(upload);
+		pendingUploads.clear();
+		stagingBuffers.clear();
+	}
+
+	void EveModel::copyFromStaging(std::unique_ptr<EveBuffer> stagingBuffer, EveBuffer &buffer, VkDeviceSize size)
+	{
+		if (!asyncUpload)
+		{
+			eveDevice.copyBuffer(stagingBuffer->getBuffer(), buffer.getBuffer(), size);
+			return;
+		}
+
+		pendingUploads.push_back(eveDevice.copyBufferAsync(stagingBuffer->getBuffer(), buffer.getBuffer(), size));
+		stagingBuffers.push_back(std::move(stagingBuffer));
+	}
+
+	void EveModel::createVertexBuffers(const void *vertices, uint32_t vertexSize, uint32_t count)
+	{
+		vertexCount = count;
 		assert(vertexCount >= 3 && "Vertex count must be at least 3");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+		VkDeviceSize bufferSize = vertexSize * vertexCount;
 
-		uint32_t vertexSize = sizeof(vertices[0]);
-		EveBuffer stagingBuffer{
+		auto stagingBuffer = std::make_unique<EveBuffer>(
 			eveDevice,
 			vertexSize,
 			vertexCount,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void *)vertices.data());
+		stagingBuffer->map();
+		stagingBuffer->writeToBuffer(const_cast<void *>(vertices));
 
 		vertexBuffer = std::make_unique<EveBuffer>(
 			eveDevice,
@@ -84,7 +140,7 @@ namespace eve
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-		eveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+		copyFromStaging(std::move(stagingBuffer), *vertexBuffer, bufferSize);
 	}
 
 	void EveModel::createIndexBuffers(const std::vector<uint32_t> &indices)
@@ -99,15 +155,15 @@ namespace eve
 
 		uint32_t indexSize = sizeof(indices[0]);
 
-		EveBuffer stagingBuffer{
+		auto stagingBuffer = std::make_unique<EveBuffer>(
 			eveDevice,
 			indexSize,
 			indexCount,
-						VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void *)indices.data());
+		stagingBuffer->map();
+		stagingBuffer->writeToBuffer((void *)indices.data());
 
 		indexBuffer = std::make_unique<EveBuffer>(
 			eveDevice,
@@ -116,11 +172,42 @@ namespace eve
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-		eveDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		copyFromStaging(std::move(stagingBuffer), *indexBuffer, bufferSize);
+	}
+
+	void EveModel::createFaceBuffer(const std::vector<uint64_t> &faces)
+	{
+		faceCount = static_cast<uint32_t>(faces.size());
+		vertexCount = faceCount * 6;
+		VkDeviceSize bufferSize = sizeof(faces[0]) * faceCount;
+
+		uint32_t faceSize = sizeof(faces[0]);
+		auto stagingBuffer = std::make_unique<EveBuffer>(
+			eveDevice,
+			faceSize,
+			faceCount,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		stagingBuffer->map();
+		stagingBuffer->writeToBuffer((void *)faces.data());
+
+		faceBuffer = std::make_unique<EveBuffer>(
+			eveDevice,
+			faceSize,
+			faceCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		copyFromStaging(std::move(stagingBuffer), *faceBuffer, bufferSize);
 	}
 
 	void EveModel::bind(VkCommandBuffer commandBuffer)
 	{
+		// face records are bound as a descriptor set by the render system
+		if (faceCount)
+			return;
+
 		VkBuffer buffers[] = {vertexBuffer->getBuffer()};
 		VkDeviceSize offsets[] = {0};
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -133,7 +220,12 @@ namespace eve
 
 	void EveModel::draw(VkCommandBuffer commandBuffer)
 	{
-		if (hasIndexBuffer)
+		if (faceCount)
+		{
+			// 6 vertices per face, the vertex shader expands them from gl_VertexIndex
+			vkCmdDraw(commandBuffer, faceCount * 6, 1, 0, 0);
+		}
+		else if (hasIndexBuffer)
 		{
 			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
 		}
@@ -143,8 +235,100 @@ namespace eve
 		}
 	}
 
-	void EveModel::swap() {
-		
+	void EveModel::draw(VkCommandBuffer commandBuffer, uint8_t sideMask)
+	{
+		if (!groupedBySide || (sideMask & 0x3F) == 0x3F)
+		{
+			draw(commandBuffer);
+			return;
+		}
+
+		// neighboring visible sides are contiguous, they go in the same draw
+		for (int side = 0; side < 6;)
+		{
+			if (!(sideMask & (1 << side)))
+			{
+				side++;
+				continue;
+			}
+
+			int last = side;
+			while (last + 1 < 6 && (sideMask & (1 << (last + 1))))
+				last++;
+
+			uint32_t first = sideOffsets[side];
+			uint32_t count = sideOffsets[last + 1] - first;
+			if (count)
+			{
+				if (faceCount)
+					vkCmdDraw(commandBuffer, count * 6, 1, first * 6, 0);
+				else
+					vkCmdDrawIndexed(commandBuffer, count, 1, first, 0, 0);
+			}
+			side = last + 1;
+		}
+	}
+
+	void EveModel::drawLayer(VkCommandBuffer commandBuffer, int layer)
+	{
+		if (layer < 0 || layer + 1 >= static_cast<int>(layerOffsets.size()))
+			return;
+
+		uint32_t first = layerOffsets[layer];
+		uint32_t count = layerOffsets[layer + 1] - first;
+		if (!count)
+			return;
+
+		if (faceCount)
+			vkCmdDraw(commandBuffer, count * 6, 1, first * 6, 0);
+		else
+			vkCmdDrawIndexed(commandBuffer, count, 1, first, 0, 0);
+	}
+
+	void EveModel::Builder::groupBySide()
+	{
+		// counting sort, the previous order is kept inside each side
+		std::array<uint32_t, 7> offsets{};
+		if (!faces.empty())
+		{
+			for (uint64_t face : faces)
+				offsets[ChunkFace::getSide(face) + 1]++;
+			for (int side = 0; side < 6; side++)
+				offsets[side + 1] += offsets[side];
+
+			thread_local std::vector<uint64_t> sorted;
+			sorted.resize(faces.size());
+			std::array<uint32_t, 7> next = offsets;
+			for (uint64_t face : faces)
+				sorted[next[ChunkFace::getSide(face)]++] = face;
+			faces.swap(sorted);
+		}
+		else if (!chunkVertices.empty())
+		{
+			// 6 indices per quad, all 4 vertices of a quad share the normal
+			for (size_t i = 0; i < indices.size(); i += 6)
+				offsets[chunkVertices[indices[i]].getNormal() + 1] += 6;
+			for (int side = 0; side < 6; side++)
+				offsets[side + 1] += offsets[side];
+
+			thread_local std::vector<uint32_t> sorted;
+			sorted.resize(indices.size());
+			std::array<uint32_t, 7> next = offsets;
+			for (size_t i = 0; i < indices.size(); i += 6)
+			{
+				uint32_t &offset = next[chunkVertices[indices[i]].getNormal()];
+				std::copy(indices.begin() + i, indices.begin() + i + 6, sorted.begin() + offset);
+				offset += 6;
+			}
+			indices.swap(sorted);
+		}
+		else
+		{
+			return;
+		}
+
+		sideOffsets = offsets;
+		groupedBySide = true;
 	}
 
 	std::vector<VkVertexInputBindingDescription> EveModel::Vertex::getBindingDescriptions()
@@ -168,29 +352,38 @@ namespace eve
 		return attributeDescriptions;
 	}
 
-	void EveModel::Builder::loadModel(const std::string &filepath, glm::vec3 color)
+	std::vector<VkVertexInputBindingDescription> EveModel::ChunkVertex::getBindingDescriptions()
 	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(ChunkVertex);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescriptions;
+	}
 
-		std::string enginePath = ENGINE_DIR + filepath;
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
-		{
-			throw std::runtime_error(warn + err);
-		}
+	std::vector<VkVertexInputAttributeDescription> EveModel::ChunkVertex::getAttributeDescriptions()
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+		attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32_UINT, 0});
 
+		return attributeDescriptions;
+	}
+
+	// the obj shapes into the builder, same vertices merged
+	static void fillFromObj(EveModel::Builder &builder, const tinyobj::attrib_t &attrib, const std::vector<tinyobj::shape_t> &shapes, glm::vec3 color)
+	{
+		std::vector<EveModel::Vertex> &vertices = builder.vertices;
+		std::vector<uint32_t> &indices = builder.indices;
 		vertices.clear();
 		indices.clear();
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		std::unordered_map<EveModel::Vertex, uint32_t> uniqueVertices{};
 
 		for (const auto &shape : shapes)
 		{
 			for (const auto &index : shape.mesh.indices)
 			{
-				Vertex vertex{};
+				EveModel::Vertex vertex{};
 
 				if (index.vertex_index >= 0)
 				{
@@ -232,4 +425,34 @@ namespace eve
 		}
 		std::cout << std::endl; // (fixme)
 	}
-}
\ No newline at end of file
+
+	void EveModel::Builder::loadModel(const std::string &filepath, glm::vec3 color)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		std::string enginePath = ENGINE_DIR + filepath;
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+		{
+			throw std::runtime_error(warn + err);
+		}
+		fillFromObj(*this, attrib, shapes, color);
+	}
+
+	void EveModel::Builder::loadModel(std::istream &stream, glm::vec3 color)
+	{
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		// no material reader, the models are colored by the caller
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream))
+		{
+			throw std::runtime_error(warn + err);
+		}
+		fillFromObj(*this, attrib, shapes, color);
+	}
+}
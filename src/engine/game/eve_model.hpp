@@ -2,11 +2,14 @@
 
 #include "../device/eve_device.hpp"
 #include "../utils/eve_buffer.hpp"
+#include "../utils/eve_task.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <array>
+#include <istream>
 #include <vector>
 #include <memory>
 
@@ -41,14 +44,86 @@ namespace eve {
 				}
 			};
 
+			/*
+			* Chunk mesh vertex, 8 bytes instead of 48 (see shaders/chunk_shader.vert)
+			* low:	position x, y, z (6 bits each, chunk corner coordinates 0..CHUNK_SIZE)
+			*		normal (3 bits, chunk neighbor order), ao (2 bits, 3 = not occluded), marked (1 bit)
+			*		uv.x (6 bits), quad corner (2 bits, picks the debug mark color)
+			* high:	uv.y (6 bits), texture layer (16 bits)
+			*/
+			struct ChunkVertex {
+				uint32_t low = 0;
+				uint32_t high = 0;
+
+				static ChunkVertex pack(glm::ivec3 position, int normal, int ao, bool marked, int corner, glm::ivec2 uv, unsigned int texId) {
+					ChunkVertex vertex;
+					vertex.low = (uint32_t(position.x) & 63u)
+						| ((uint32_t(position.y) & 63u) << 6)
+						| ((uint32_t(position.z) & 63u) << 12)
+						| ((uint32_t(normal) & 7u) << 18)
+						| ((uint32_t(ao) & 3u) << 21)
+						| (uint32_t(marked) << 23)
+						| ((uint32_t(uv.x) & 63u) << 24)
+						| ((uint32_t(corner) & 3u) << 30);
+					vertex.high = (uint32_t(uv.y) & 63u)
+						| ((texId & 0xFFFFu) << 6);
+					return vertex;
+				}
+				int getNormal() const { return int((low >> 18) & 7u); }
+
+				static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+				static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			};
+			static_assert(sizeof(ChunkVertex) == 8, "ChunkVertex must stay packed");
+
+			/*
+			* One chunk face for vertex pulling (see shaders/chunk_face_shader.vert), no vertex nor index buffer.
+			* The face covers one cell layer along its normal: cell is the min cell of the solid layer right behind the face.
+			* low:	min cell x, y, z (5 bits each), width - 1, height - 1 (4 bits each, along the side plane axes)
+			*		side (3 bits, chunk neighbor order), marked (1 bit)
+			* high:	ao of the 4 quad corners (2 bits each), texture layer (16 bits)
+			*/
+			struct ChunkFace {
+				static uint64_t pack(glm::ivec3 cell, int side, int width, int height, uint8_t ao, bool marked, unsigned int texId) {
+					uint32_t low = (uint32_t(cell.x) & 31u)
+						| ((uint32_t(cell.y) & 31u) << 5)
+						| ((uint32_t(cell.z) & 31u) << 10)
+						| ((uint32_t(width - 1) & 15u) << 15)
+						| ((uint32_t(height - 1) & 15u) << 19)
+						| ((uint32_t(side) & 7u) << 23)
+						| (uint32_t(marked) << 26);
+					uint32_t high = uint32_t(ao)
+						| ((texId & 0xFFFFu) << 8);
+					return uint64_t(low) | (uint64_t(high) << 32);
+				}
+				static int getSide(uint64_t face) { return int((face >> 23) & 7u); }
+			};
+
 			struct Builder {
 				std::vector<Vertex> vertices{};
+				std::vector<ChunkVertex> chunkVertices{}; // used instead of vertices when not empty
+				std::vector<uint64_t> faces{}; // ChunkFace records, used instead of any vertex when not empty
 				std::vector<uint32_t> indices{};
 
+				/*
+				* Chunk meshes grouped by side (chunk neighbor order): side s covers sideOffsets[s] to sideOffsets[s + 1],
+				* counted in faces for face records and in indices for chunk vertices. Lets the renderer skip the sides
+				* that can't face the camera.
+				* */
+				bool groupedBySide = false;
+				std::array<uint32_t, 7> sideOffsets{};
+				// meshes drawn one layer at a time (chunk cut caps): layer l covers layerOffsets[l] to layerOffsets[l + 1], same units
+				std::vector<uint32_t> layerOffsets{};
+
 				void loadModel(const std::string &filepath, glm::vec3 color);
+				// obj data already in memory (see loadModelAsync)
+				void loadModel(std::istream &stream, glm::vec3 color);
+				// sorts the faces (or the quads of the index buffer) by side, stable inside a side
+				void groupBySide();
 			};
 			
-			EveModel(EveDevice &device, const EveModel::Builder &builder);
+			// asyncUpload: the copies aren't waited for, finishUpload has to release the staging buffers (main thread)
+			EveModel(EveDevice &device, const EveModel::Builder &builder, bool asyncUpload = false);
 			~EveModel();
 
 			EveModel(const EveModel&) = delete;
@@ -56,28 +131,53 @@ namespace eve {
 
 			static std::unique_ptr<EveModel> createModelFromFile(EveDevice &device, const std::string &filepath, glm::vec3 color);
 			static std::unique_ptr<EveModel> createCubeModel(EveDevice &device);
+			// obj read and parsed on the background lane, buffers are created back on the main thread
+			static Task<std::shared_ptr<EveModel>> loadModelAsync(EveDevice &device, EveScheduler &scheduler, std::string filepath, glm::vec3 color);
+			// waits for the copies of an asyncUpload model (fenceSignaled) and releases its staging buffers, spawn it
+			static Task<> finishUpload(std::shared_ptr<EveModel> model, EveScheduler &scheduler);
 
 			void bind(VkCommandBuffer commandBuffer);
 			void draw(VkCommandBuffer commandBuffer);
+			// only the sides of sideMask (bit n: side n), the whole mesh when it isn't grouped by side
+			void draw(VkCommandBuffer commandBuffer, uint8_t sideMask);
+			// only the given layer of a mesh built with layerOffsets
+			void drawLayer(VkCommandBuffer commandBuffer, int layer);
 
-			void swap();
+			// built from chunk vertices, has to be drawn with the chunk pipeline
+			bool hasChunkVertices() const { return chunkVertices; }
+			// built from face records, has to be drawn by ChunkFaceRenderSystem
+			bool hasFaceRecords() const { return faceCount > 0; }
+			VkDescriptorBufferInfo getFaceBufferInfo() { return faceBuffer->descriptorInfo(); }
 
 		private:
-			void createVertexBuffers(const std::vector<Vertex> &vertices);
+			void createVertexBuffers(const void *vertices, uint32_t vertexSize, uint32_t count);
 			void createIndexBuffers(const std::vector<uint32_t> &indices);
+			void createFaceBuffer(const std::vector<uint64_t> &faces);
+			// into a device local buffer, waited for unless asyncUpload
+			void copyFromStaging(std::unique_ptr<EveBuffer> stagingBuffer, EveBuffer &buffer, VkDeviceSize size);
+			void releaseUploads();
 
 			EveDevice &eveDevice;
 
-			bool needSwap = false;
+			bool asyncUpload = false;
+			std::vector<PendingUpload> pendingUploads;
+			std::vector<std::unique_ptr<EveBuffer>> stagingBuffers;
+
+			bool chunkVertices = false;
 
-			std::unique_ptr<EveBuffer> stagingVertexBuffer;
 			std::unique_ptr<EveBuffer> vertexBuffer;
 			uint32_t vertexCount;
 
 			bool hasIndexBuffer = false;
 
-			std::unique_ptr<EveBuffer> stagingIndexBuffer;
 			std::unique_ptr<EveBuffer> indexBuffer;
 			uint32_t indexCount;
+
+			std::unique_ptr<EveBuffer> faceBuffer;
+			uint32_t faceCount = 0;
+
+			bool groupedBySide = false;
+			std::array<uint32_t, 7> sideOffsets{};
+			std::vector<uint32_t> layerOffsets;
 	};
 }
\ No newline at end of file
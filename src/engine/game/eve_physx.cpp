@@ -1,9 +1,15 @@
 #include "eve_physx.hpp"
+#include "eve_voxel_shape.hpp"
 #include <Jolt/Physics/Collision/Shape/RotatedTranslatedShape.h>
+#include <Jolt/Physics/Body/BodyLockMulti.h>
+
+#include <easy/profiler.h>
+
+#include <algorithm>
 
 namespace eve {
 
-	EvePhysx::EvePhysx() {
+	EvePhysx::EvePhysx(EveScheduler &scheduler) : job_system{scheduler} {
 		initPhysx();
 		//createHelloShapes();
 	}
@@ -32,6 +38,8 @@ namespace eve {
 		// If you have your own custom shape types you probably need to register their handlers with the CollisionDispatch before calling this function.
 		// If you implement your own default material (PhysicsMaterial::sDefault) make sure to initialize it before this function or else this function will create one for you.
 		RegisterTypes();
+		// the chunk colliders, on top of the default handlers
+		EveVoxelShape::sRegister();
 
 		// Now we can create the actual physics system.
 		physics_system.Init(cMaxBodies, cNumBodyMutexes, cMaxBodyPairs, cMaxContactConstraints, broad_phase_layer_interface, object_vs_broadphase_layer_filter, object_vs_object_layer_filter);
@@ -52,7 +60,6 @@ namespace eve {
 		body_interface = &physics_system.GetBodyInterface();
 
 		temp_allocator = new TempAllocatorImpl(10 * 1024 * 1024);
-		job_system = new JobSystemThreadPool(cMaxPhysicsJobs, cMaxPhysicsBarriers, thread::hardware_concurrency() - 1);
 	}
 
 
@@ -103,22 +110,251 @@ namespace eve {
 		return id;
 	}
 
-	void EvePhysx::tick(float deltaTime) {
-		//if (body_interface->IsActive(sphere_id)) {
-			// Output current position and velocity of the sphere
-			RVec3 position = body_interface->GetCenterOfMassPosition(sphere_id);
-			Vec3 velocity = body_interface->GetLinearVelocity(sphere_id);
-			//cout << "Step " << ": Position = (" << position.GetX() << ", " << position.GetY() << ", " << position.GetZ() << "), Velocity = (" << velocity.GetX() << ", " << velocity.GetY() << ", " << velocity.GetZ() << ")" << endl;
+	void EvePhysx::start() {
+		if (running)
+			return;
+		running = true;
+		physicsThread = boost::thread(&EvePhysx::physicsLoop, this);
+	}
+
+	void EvePhysx::stop() {
+		running = false;
+		if (physicsThread.joinable())
+			physicsThread.join();
+	}
+
+	void EvePhysx::physicsLoop() {
+		EASY_THREAD("Physics");
+		using clock = std::chrono::high_resolution_clock;
+
+		auto previousTime = clock::now();
+		float accumulator = 0.f;
+		while (running) {
+			auto now = clock::now();
+			accumulator += std::chrono::duration<float, std::chrono::seconds::period>(now - previousTime).count();
+			previousTime = now;
+
+			accumulator = std::min(accumulator, FIXED_STEP * MAX_SUB_STEPS);
+			while (accumulator >= FIXED_STEP) {
+				step();
+				accumulator -= FIXED_STEP;
+			}
+
+			// until the next step is due
+			boost::this_thread::sleep_for(boost::chrono::microseconds(int((FIXED_STEP - accumulator) * 1000000.f)));
+		}
+	}
+
+	void EvePhysx::step() {
+		EASY_FUNCTION(profiler::colors::Orange);
+		auto stepStart = std::chrono::high_resolution_clock::now();
+
+		flushBodies();
 
-			// If you take larger steps than 1 / 60th of a second you need to do multiple collision steps in order to keep the simulation stable. Do 1 collision step per 1 / 60th of a second (round up).
-			const int cCollisionSteps = 1;
+		// one collision step is enough at 60 Hz
+		const int cCollisionSteps = 1;
+		physics_system.Update(FIXED_STEP, cCollisionSteps, temp_allocator, &job_system);
+
+		publishStates();
+		lastStepMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - stepStart).count();
+	}
 
-			// Step the world
-			physics_system.Update(deltaTime, cCollisionSteps, temp_allocator, job_system);
-		//}
+	void EvePhysx::publishStates() {
+		EASY_FUNCTION(profiler::colors::Orange);
+		stepCount++;
+		{
+			boost::lock_guard<boost::mutex> lock(stateMutex);
+			// tracked since the last step
+			publishBodies.insert(publishBodies.end(), trackedBodies.begin() + publishBodies.size(), trackedBodies.end());
+		}
+		activeSlots.resize(publishBodies.size(), NO_SLOT);
+
+		writtenStates.clear();
+		for (size_t i = 0; i < settlingStates.size();) {
+			writtenStates.push_back(settlingStates[i].first);
+			if (--settlingStates[i].second > 0) {
+				i++;
+				continue;
+			}
+			settlingStates[i] = settlingStates.back();
+			settlingStates.pop_back();
+		}
+
+		body_activation_listener.drain(activationEvents);
+		for (const MyBodyActivationListener::Event &event : activationEvents) {
+			if (event.stateIndex >= activeSlots.size())
+				continue;
+
+			uint32_t &slot = activeSlots[event.stateIndex];
+			if (event.active && slot == NO_SLOT) {
+				slot = uint32_t(activeStates.size());
+				activeStates.push_back(event.stateIndex);
+			}
+			else if (!event.active && slot != NO_SLOT) {
+				// swap remove
+				activeSlots[activeStates.back()] = slot;
+				activeStates[slot] = activeStates.back();
+				activeStates.pop_back();
+				slot = NO_SLOT;
+
+				// where it stopped, into the other buffers too
+				writtenStates.push_back(event.stateIndex);
+				settlingStates.push_back({event.stateIndex, 2});
+			}
+		}
+		writtenStates.insert(writtenStates.end(), activeStates.begin(), activeStates.end());
+
+		writtenBodies.clear();
+		for (uint32_t index : writtenStates)
+			writtenBodies.push_back(publishBodies[index]);
+
+		publishBuffer.resize(publishBodies.size());
+		{
+			// one pass over the body mutexes for the whole batch
+			BodyLockMultiRead lock(physics_system.GetBodyLockInterface(), writtenBodies.data(), int(writtenBodies.size()));
+			for (size_t i = 0; i < writtenBodies.size(); i++) {
+				const Body *body = lock.GetBody(int(i));
+				if (!body)
+					continue;
+
+				EveBodyState &state = publishBuffer[writtenStates[i]];
+				RVec3 position = body->GetPosition();
+				Quat rotation = body->GetRotation();
+
+				// y is flipped between the physics and the render, so is the rotation around x and z
+				state.position = glm::vec3(position.GetX(), -position.GetY(), position.GetZ());
+				state.rotation = glm::quat(rotation.GetW(), -rotation.GetX(), rotation.GetY(), -rotation.GetZ());
+				state.bounds = body->GetWorldSpaceBounds();
+				state.velocity = body->GetLinearVelocity();
+				state.step = stepCount;
+			}
+		}
+
+		boost::lock_guard<boost::mutex> lock(stateMutex);
+		std::swap(previousStates, currentStates);
+		std::swap(currentStates, publishBuffer);
+		currentStateTime = std::chrono::high_resolution_clock::now();
+		publishedStep = stepCount;
+
+		movedFlags.resize(publishBodies.size(), 0);
+		for (uint32_t index : writtenStates) {
+			if (movedFlags[index])
+				continue;
+			movedFlags[index] = 1;
+			movedStates.push_back(index);
+		}
+	}
+
+	BodyID EvePhysx::createTrackedBody(BodyCreationSettings settings, uint32_t &outStateIndex) {
+		// the index is in the user data before the body can activate
+		boost::lock_guard<boost::mutex> lock(stateMutex);
+		outStateIndex = uint32_t(trackedBodies.size());
+		settings.mUserData = outStateIndex + 1;
+
+		BodyID id = createBodyDeferred(settings, EActivation::Activate);
+		if (!id.IsInvalid())
+			trackedBodies.push_back(id);
+		return id;
+	}
+
+	float EvePhysx::readMovedStates(std::vector<uint32_t> &ioIndices, std::vector<EveBodyState> &ioPrevious, std::vector<EveBodyState> &ioCurrent) {
+		EASY_FUNCTION(profiler::colors::Orange);
+		boost::lock_guard<boost::mutex> lock(stateMutex);
+		if (readStep != publishedStep) {
+			readStep = publishedStep;
+			ioIndices.clear();
+			ioPrevious.clear();
+			ioCurrent.clear();
+			for (uint32_t index : movedStates) {
+				movedFlags[index] = 0;
+				ioIndices.push_back(index);
+				ioPrevious.push_back(index < previousStates.size() ? previousStates[index] : EveBodyState{});
+				ioCurrent.push_back(currentStates[index]);
+			}
+			movedStates.clear();
+		}
+
+		float sinceStep = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - currentStateTime).count();
+		return std::clamp(sinceStep / FIXED_STEP, 0.f, 1.f);
+	}
+
+	BodyID EvePhysx::createBodyDeferred(const BodyCreationSettings &settings, EActivation activation) {
+		Body *body = body_interface->CreateBody(settings);
+		if (!body) {
+			std::cout << "Out of physics bodies" << std::endl;
+			return BodyID();
+		}
+
+		boost::lock_guard<boost::mutex> lock(pendingBodiesMutex);
+		(activation == EActivation::Activate ? pendingActiveAdds : pendingAdds).push_back(body->GetID());
+		return body->GetID();
+	}
+
+	void EvePhysx::removeBodyDeferred(const BodyID &id) {
+		{
+			boost::lock_guard<boost::mutex> lock(pendingBodiesMutex);
+			auto it = std::find(pendingAdds.begin(), pendingAdds.end(), id);
+			auto activeIt = std::find(pendingActiveAdds.begin(), pendingActiveAdds.end(), id);
+			if (it != pendingAdds.end())
+				pendingAdds.erase(it);
+			else if (activeIt != pendingActiveAdds.end())
+				pendingActiveAdds.erase(activeIt);
+			else {
+				pendingRemoves.push_back(id);
+				return;
+			}
+		}
+		// never added
+		body_interface->DestroyBody(id);
+	}
+
+	void EvePhysx::activateBodiesDeferred(const AABox &box) {
+		boost::lock_guard<boost::mutex> lock(pendingBodiesMutex);
+		pendingActivations.push_back(box);
+	}
+
+	void EvePhysx::flushBodies() {
+		EASY_FUNCTION(profiler::colors::Orange);
+		std::vector<BodyID> adds;
+		std::vector<BodyID> activeAdds;
+		std::vector<BodyID> removes;
+		std::vector<AABox> activations;
+		{
+			boost::lock_guard<boost::mutex> lock(pendingBodiesMutex);
+			adds.swap(pendingAdds);
+			activeAdds.swap(pendingActiveAdds);
+			removes.swap(pendingRemoves);
+			activations.swap(pendingActivations);
+		}
+
+		if (!removes.empty()) {
+			body_interface->RemoveBodies(removes.data(), int(removes.size()));
+			body_interface->DestroyBodies(removes.data(), int(removes.size()));
+		}
+
+		if (!activeAdds.empty()) {
+			BodyInterface::AddState state = body_interface->AddBodiesPrepare(activeAdds.data(), int(activeAdds.size()));
+			body_interface->AddBodiesFinalize(activeAdds.data(), int(activeAdds.size()), state, EActivation::Activate);
+		}
+
+		if (!adds.empty()) {
+			// one broadphase insertion for the whole batch
+			BodyInterface::AddState state = body_interface->AddBodiesPrepare(adds.data(), int(adds.size()));
+			body_interface->AddBodiesFinalize(adds.data(), int(adds.size()), state, EActivation::DontActivate);
+			addedSinceOptimize += adds.size();
+		}
+		else if (addedSinceOptimize >= optimizeBroadPhaseThreshold) {
+			physics_system.OptimizeBroadPhase();
+			addedSinceOptimize = 0;
+		}
+
+		for (const AABox &box : activations)
+			body_interface->ActivateBodiesInAABox(box, BroadPhaseLayerFilter(), ObjectLayerFilter());
 	}
 
 	void EvePhysx::destroy() {
+		stop();
+
 		// Remove the sphere from the physics system. Note that the sphere itself keeps all of its state and can be re-added at any time.
 		/*body_interface->RemoveBody(sphere_id);
 
@@ -12,7 +12,6 @@
 #include <Jolt/RegisterTypes.h>
 #include <Jolt/Core/Factory.h>
 #include <Jolt/Core/TempAllocator.h>
-#include <Jolt/Core/JobSystemThreadPool.h>
 #include <Jolt/Physics/PhysicsSettings.h>
 #include <Jolt/Physics/PhysicsSystem.h>
 #include <Jolt/Physics/Collision/Shape/BoxShape.h>
@@ -21,16 +20,21 @@
 #include <Jolt/Physics/Body/BodyActivationListener.h>
 #include <Jolt/Physics/Collision/Shape/MutableCompoundShape.h>
 #include <Jolt/Physics/Collision/Shape/RotatedTranslatedShape.h>
+#include <Jolt/Geometry/AABox.h>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtc/matrix_transform.hpp>
 #include "glm/ext.hpp"
 #include "glm/gtx/hash.hpp"
 
+#include "../utils/eve_scheduler.hpp"
+
 // STL includes
 #include <iostream>
 #include <cstdarg>
 #include <thread>
+#include <atomic>
+#include <chrono>
 
 namespace eve {
 
@@ -184,23 +188,58 @@ namespace eve {
 			}
 	};
 
-	// An example activation listener
+	/*
+	* Queues the activations of the tracked bodies (user data: state index + 1, see EvePhysx::createTrackedBody),
+	* the physics thread drains them after each step to know which states to publish. The other bodies are ignored.
+	* */
 	class MyBodyActivationListener : public BodyActivationListener {
 		public:
+			struct Event {
+				uint32_t stateIndex;
+				bool active;
+			};
+
 			virtual void		OnBodyActivated(const BodyID &inBodyID, uint64 inBodyUserData) override
 			{
-				cout << "A body got activated" << endl;
+				push(inBodyUserData, true);
 			}
 
 			virtual void		OnBodyDeactivated(const BodyID &inBodyID, uint64 inBodyUserData) override
 			{
-				cout << "A body went to sleep" << endl;
+				push(inBodyUserData, false);
+			}
+
+			void drain(std::vector<Event> &outEvents) {
+				outEvents.clear();
+				boost::lock_guard<boost::mutex> lock(mutex);
+				outEvents.swap(events);
+			}
+
+		private:
+			// called from the physics jobs
+			void push(uint64 userData, bool active) {
+				if (userData == 0)
+					return;
+				boost::lock_guard<boost::mutex> lock(mutex);
+				events.push_back({uint32_t(userData - 1), active});
 			}
+
+			boost::mutex mutex;
+			std::vector<Event> events;
+	};
+
+	// a tracked body after a physics step
+	struct EveBodyState {
+		glm::vec3 position{0.f};					// render space (y down)
+		glm::quat rotation{1.f, 0.f, 0.f, 0.f};		// render space
+		AABox bounds;								// physics space
+		Vec3 velocity = Vec3::sZero();				// physics space
+		uint32_t step = 0;							// physics step that wrote it, 0: never
 	};
 
 	class EvePhysx {
 		public:
-			EvePhysx();
+			EvePhysx(EveScheduler &scheduler);
 			~EvePhysx();
 
 			EvePhysx(const EvePhysx&) = delete;
@@ -209,9 +248,45 @@ namespace eve {
 			void initPhysx();
 			void createHelloShapes();
 			BodyID createStaticPlane(glm::vec3 size, glm::vec3 pos, glm::vec3 offset);
-			void tick(float deltaTime);
 			void destroy();
 
+			/*
+			* The simulation steps at a fixed rate on its own thread, Jolt's jobs still go to the physics lane of the scheduler.
+			* A late thread catches up with at most MAX_SUB_STEPS steps and drops the rest of the time (the simulation slows
+			* down instead of spiraling). The last two states of the tracked bodies are kept, the render interpolates between
+			* them one step behind, whatever its own frame rate.
+			* Only the bodies the activation listener reports active are read after a step (one BodyLockMultiRead for all of them),
+			* plus two more steps once they fall asleep so the three buffers hold where they stopped.
+			* */
+			static constexpr float FIXED_STEP = 1.f / 60.f;
+			static constexpr int MAX_SUB_STEPS = 4;
+			void start();
+			void stop();
+
+			// deferred dynamic body activated when added, outStateIndex: where its states are published (takes the body user data)
+			BodyID createTrackedBody(BodyCreationSettings settings, uint32_t &outStateIndex);
+			/*
+			* Packed states (index, previous, current) of the bodies that moved since the last call,
+			* left as they are when no step ran since: the caller keeps interpolating them.
+			* Returns where now is between the last two steps (0: previous, 1: current).
+			* */
+			float readMovedStates(std::vector<uint32_t> &ioIndices, std::vector<EveBodyState> &ioPrevious, std::vector<EveBodyState> &ioCurrent);
+			std::atomic<float> lastStepMs{0.f};
+
+			/*
+			* Streamed bodies (terrain colliders) are created right away by any thread but only added to the simulation
+			* in batches by flushBodies, on the physics thread before each step. Their removal waits for the same flush,
+			* a body removed before its batch went in is only destroyed.
+			* A streaming burst (at least optimizeBroadPhaseThreshold bodies added, then a flush without any) is followed
+			* by OptimizeBroadPhase, the bodies added one batch at a time leave the broadphase tree unbalanced.
+			* */
+			BodyID createBodyDeferred(const BodyCreationSettings &settings, EActivation activation = EActivation::DontActivate); // invalid when out of bodies
+			void removeBodyDeferred(const BodyID &id);
+			// wakes the bodies in the box with the next flush, the simulation may be stepping
+			void activateBodiesDeferred(const AABox &box);
+			void flushBodies();
+			size_t optimizeBroadPhaseThreshold = 256;
+
 			PhysicsSystem physics_system;
 			BodyInterface *body_interface;
 
@@ -265,10 +340,48 @@ namespace eve {
 			// malloc / free.
 			TempAllocatorImpl *temp_allocator;
 
-			// We need a job system that will execute physics jobs on multiple threads. Typically
-			// you would implement the JobSystem interface yourself and let Jolt Physics run on top
-			// of your own job scheduler. JobSystemThreadPool is an example implementation.
-			JobSystemThreadPool *job_system;
+			// Physics jobs run on the engine scheduler (physics lane) so jolt and the terrain
+			// workers share the same threads instead of oversubscribing the cores.
+			EveScheduler &job_system;
+
+		private:
+			void physicsLoop();
+			void step();
+			void publishStates();
+
+			boost::mutex pendingBodiesMutex;
+			std::vector<BodyID> pendingAdds;
+			std::vector<BodyID> pendingActiveAdds; // added with EActivation::Activate
+			std::vector<BodyID> pendingRemoves;
+			std::vector<AABox> pendingActivations;
+			size_t addedSinceOptimize = 0;
+
+			boost::thread physicsThread;
+			std::atomic<bool> running{false};
+
+			boost::mutex stateMutex;
+			std::vector<BodyID> trackedBodies;
+			std::vector<EveBodyState> previousStates;
+			std::vector<EveBodyState> currentStates;
+			std::chrono::high_resolution_clock::time_point currentStateTime;
+			uint32_t publishedStep = 0;
+			uint32_t readStep = 0;
+			// written since the last readMovedStates
+			std::vector<uint32_t> movedStates;
+			std::vector<uint8_t> movedFlags;
+
+			// physics thread only
+			uint32_t stepCount = 0;
+			std::vector<BodyID> publishBodies;					// copy of trackedBodies
+			// written in turn, previousStates <- currentStates <- publishBuffer
+			std::vector<EveBodyState> publishBuffer;
+			std::vector<MyBodyActivationListener::Event> activationEvents;
+			std::vector<uint32_t> activeStates;					// packed
+			std::vector<uint32_t> activeSlots;					// [state index] -> activeStates, NO_SLOT when asleep
+			std::vector<std::pair<uint32_t, int>> settlingStates;	// fell asleep, steps left to publish
+			std::vector<uint32_t> writtenStates;
+			std::vector<BodyID> writtenBodies;
+			static constexpr uint32_t NO_SLOT = ~0u;
 			
 	};
 }
\ No newline at end of file
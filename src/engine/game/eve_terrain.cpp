@@ -1,16 +1,34 @@
 #include "eve_terrain.hpp"
 #include "../utils/eve_utils.hpp"
+#include "../rendering/eve_swap_chain.hpp"
 #include <utility>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
 
 namespace eve {
 
-	EveTerrain::EveTerrain(EveDevice &device, EvePhysx &physx) : eveDevice{device}, evePhysx{physx} {
+	EveTerrain::EveTerrain(EveDevice &device, EvePhysx &physx, EveScheduler &scheduler) : eveDevice{device}, evePhysx{physx}, eveScheduler{scheduler}, chunkPool{scheduler} {
 		voxelMap.push_back(new EveVoxel(0, "air", false));
 		voxelMap.push_back(new EveVoxel(1, "stone", true));
+		voxelMap.push_back(new EveVoxel(2, "dirt", true));
+		voxelMap.push_back(new EveVoxel(3, "water", false, true));
 		init();
+		spawn(loadModels());
+	}
+
+	Task<> EveTerrain::loadModels() {
+		eveCube = co_await EveModel::loadModelAsync(eveDevice, eveScheduler, "gamedata/core/models/cube.obj", glm::vec3(1, 0, 0));
+		eveQuad = co_await EveModel::loadModelAsync(eveDevice, eveScheduler, "gamedata/core/models/quad.obj", glm::vec3(1));
+		eveQuadR = co_await EveModel::loadModelAsync(eveDevice, eveScheduler, "gamedata/core/models/quad.obj", glm::vec3(1, 0, 0));
+		eveQuadG = co_await EveModel::loadModelAsync(eveDevice, eveScheduler, "gamedata/core/models/quad.obj", glm::vec3(0, 1, 0));
+		eveQuadB = co_await EveModel::loadModelAsync(eveDevice, eveScheduler, "gamedata/core/models/quad.obj", glm::vec3(0, 0, 1));
 	}
 
 	EveTerrain::~EveTerrain() {
+		chunkPool.destroy();
 		/*remeshingCandidates.clear();
 		remeshingProcessing.clear();
 		remeshingProcessed.clear();
@@ -90,70 +108,306 @@ namespace eve {
 				}
 			}
 		}
+		chunkGrid = std::move(generated);
 	}
 
 	void EveTerrain::onMouseWheel(GLFWwindow *window, double xoffset, double yoffset) {
+		// the cut is a shader clip plane plus the caps of its layer, scrolling doesn't remesh anything
 		playerCurrentLevel += -yoffset;
 		std::cout << "level: " << playerCurrentLevel << std::endl;
-		vkDeviceWaitIdle(eveDevice.device());
-		boost::lock_guard<boost::mutex> lock(mutex);
-		for (auto it = chunkMap.begin(); it != chunkMap.end();) {
-			Chunk *chunk = it->second;
-			if ((chunk->position.y <= playerCurrentLevel + CHUNK_SIZE / 2) &&
-			(chunk->position.y >= playerCurrentLevel - CHUNK_SIZE / 2)) {
-				std::cout << glm::to_string(chunk->position) << std::endl;
-				boost::lock_guard<boost::mutex> lock2(chunk->mutex);
-				remeshingCandidates.push_back(chunk);
-				chunkMap.erase(it++);
-				//it++;
+	}
+
+	int EveTerrain::getCutLayer(const Chunk &chunk) const {
+		if (!cutEnabled)
+			return -1;
+		int layer = playerCurrentLevel - (chunk.position.y - CHUNK_SIZE / 2);
+		return layer >= 0 && layer < CHUNK_SIZE ? layer : -1;
+	}
+
+	size_t EveTerrain::getInFlightJobs() const {
+		return noisingProcessing.size() + remeshingProcessing.size() + colliderProcessing.size() + capProcessing.size();
+	}
+
+	size_t EveTerrain::getMeshingBacklog() const {
+		return noisingProcessed.size() + remeshingCandidates.size() + remeshingProcessing.size() + remeshingProcessed.size() + integrationQueue.size();
+	}
+
+	bool EveTerrain::isMeshingSaturated() const {
+		return getInFlightJobs() >= static_cast<size_t>(maxInFlightJobs) || pendingMeshBytes >= maxPendingMeshBytes;
+	}
+
+	bool EveTerrain::isNoisingSaturated() const {
+		return isMeshingSaturated() || getMeshingBacklog() >= static_cast<size_t>(maxInFlightJobs);
+	}
+
+	void EveTerrain::integrateChunk(Chunk *chunk, glm::vec3 cameraPosition) {
+		EASY_FUNCTION(profiler::colors::Magenta);
+		boost::lock_guard<boost::mutex> lock(chunk->mutex);
+
+		// only the sections meshed since the last integration are uploaded, the others keep their model
+		for (int i = 0; i < Chunk::SECTION_COUNT; i++) {
+			if (!(chunk->uploadSections & (1 << i)))
+				continue;
+
+			// the previous mesh is drawn until here, the new one takes its place in the same object
+			Chunk::ChunkSection &section = chunk->sections[i];
+			std::shared_ptr<EveModel> previous = std::move(section.model);
+
+			if (section.builder.vertices.size() || section.builder.chunkVertices.size() || section.builder.faces.size()) {
+				section.model = uploadModel(section.builder);
+				glm::vec3 translation = chunk->position;
+				// chunk vertices and faces are stored from the chunk corner
+				if (section.model->hasChunkVertices() || section.model->hasFaceRecords())
+					translation -= glm::vec3(CHUNK_SIZE / 2);
+
+				auto it = section.hasObject ? chunk->chunkObjectMap.find(section.objectId) : chunk->chunkObjectMap.end();
+				if (it != chunk->chunkObjectMap.end()) {
+					it->second.model = section.model;
+					it->second.transform.translation = translation;
+				}
+				else {
+					auto object = EveGameObject::createGameObject();
+					object.model = section.model;
+					object.transform.translation = translation;
+					section.objectId = object.getId();
+					section.hasObject = true;
+					chunk->chunkObjectMap.emplace(object.getId(), std::move(object));
+				}
 			}
-			else {
-				it++;
+			else if (section.hasObject) {
+				chunk->chunkObjectMap.erase(section.objectId);
+				section.hasObject = false;
 			}
+			retireModel(std::move(previous));
+
+			// the mesh lives on the gpu now, the cpu copy only counts against the pending budget
+			chunk->releasePendingMesh(section);
 		}
+		chunk->uploadSections = 0;
+
+		if (chunk->uploadCaps) {
+			retireModel(std::move(chunk->capModel));
+			chunk->capModel.reset();
+			if (chunk->capBuilder.chunkVertices.size() || chunk->capBuilder.faces.size())
+				chunk->capModel = uploadModel(chunk->capBuilder);
+			chunk->capBuilder = EveModel::Builder();
+			chunk->uploadCaps = false;
+		}
+
+		// new translucent faces are sorted right away, the previous model is drawn until then
+		if (chunk->uploadTranslucent || chunk->resortTranslucent) {
+			rebuildTranslucentModel(chunk, cameraPosition);
+			chunk->uploadTranslucent = false;
+			chunk->resortTranslucent = false;
+		}
+
+		chunkMap.emplace(chunk->id, chunk);
+		chunk->isQueued = false;
+		chunk->setStage(CHUNK_STAGE_UPLOADED);
+	}
+
+	std::shared_ptr<EveModel> EveTerrain::uploadModel(const EveModel::Builder &builder) {
+		// the copies run behind the frame, the staging buffers go once their fence is signaled
+		auto model = std::make_shared<EveModel>(eveDevice, builder, true);
+		spawn(EveModel::finishUpload(model, eveScheduler));
+		return model;
 	}
 
-	void EveTerrain::tick(float deltaTime) {
+	void EveTerrain::retireModel(std::shared_ptr<EveModel> model) {
+		if (!model)
+			return;
+		boost::lock_guard<boost::mutex> lock(retiredModelsMutex);
+		retiredModels.emplace_back(std::move(model), frameCount.load());
+	}
+
+	void EveTerrain::releaseRetiredModels() {
+		EASY_BLOCK("Release retired models");
+		// one frame of margin, a model retired by a worker may still get recorded in the frame of its retirement
+		boost::lock_guard<boost::mutex> lock(retiredModelsMutex);
+		auto it = std::remove_if(retiredModels.begin(), retiredModels.end(), [this](const auto &retired) {
+			return retired.second + EveSwapChain::MAX_FRAMES_IN_FLIGHT < frameCount;
+		});
+		retiredModels.erase(it, retiredModels.end());
+	}
+
+	bool EveTerrain::setVoxelAt(glm::ivec3 pos, EveVoxel *voxel) {
 		EASY_FUNCTION(profiler::colors::Magenta);
-		EASY_BLOCK("Terrain Tick");
+		Chunk *chunk = findContainerChunkAt(pos);
+		if (!chunk)
+			return false;
+
+		// chunk corner space of the edited cell
+		glm::ivec3 cell = pos - chunk->position + CHUNK_SIZE / 2;
+		spawn(applyVoxelEdit(chunk, cell, voxel));
+		return true;
+	}
+
+	Task<> EveTerrain::applyVoxelEdit(Chunk *chunk, glm::ivec3 cell, EveVoxel *voxel) {
+		unsigned int generation = resetCount;
+		// the noise job would overwrite it
+		if (!co_await chunk->reached(CHUNK_STAGE_NOISED) || generation != resetCount)
+			co_return;
 
-		int passed = 0;
-		// Mark processed chunks as available for rendering
 		{
-			boost::lock_guard<boost::mutex> lock(mutex);
-			auto it = remeshingProcessed.begin();
-			for (;it != remeshingProcessed.end();) {
-				Chunk *chunk = *it;
+			boost::lock_guard<boost::mutex> lock(chunk->mutex);
+			chunk->setVoxel(cell, voxel);
+		}
 
-				passed++;
-				if (chunk) {
-					if (chunk->id) {
-						if (chunk->chunkBuilder.vertices.size()) {
-							/*if (chunk->root->position == glm::vec3(-16, -16, -16)) {
-								std::cout << "uwu";
-							}*/
-							chunk->chunkModel = std::make_unique<EveModel>(eveDevice, chunk->chunkBuilder);
-							auto object = EveGameObject::createGameObject();
-							object.model = chunk->chunkModel;
-							object.transform.translation = chunk->position;
-							chunk->chunkObjectMap.emplace(object.getId(), std::move(object));
-						}
-						chunkMap.emplace(chunk->id, chunk);
-						chunk->isQueued = false;
-						remeshingProcessed.erase(std::find(remeshingProcessed.begin(), remeshingProcessed.end(), *it));
+		// every section holding one of the 26 neighbors sees the edit, through face culling or ao
+		std::vector<std::pair<Chunk*, uint8_t>> touched;
+		for (int z = -1; z <= 1; z++) {
+			for (int y = -1; y <= 1; y++) {
+				for (int x = -1; x <= 1; x++) {
+					glm::ivec3 neighborCell = cell + glm::ivec3(x, y, z);
+					glm::ivec3 direction(0);
+					for (int axis = 0; axis < 3; axis++) {
+						direction[axis] = neighborCell[axis] < 0 ? -1 : neighborCell[axis] >= CHUNK_SIZE ? 1 : 0;
+						neighborCell[axis] -= direction[axis] * CHUNK_SIZE;
 					}
+					Chunk *target = chunk->getNeighborChunk(direction);
+					if (!target)
+						continue;
+
+					uint8_t sectionBit = 1 << Chunk::getSectionAt(neighborCell);
+					auto it = std::find_if(touched.begin(), touched.end(), [target](const auto &entry) { return entry.first == target; });
+					if (it == touched.end())
+						touched.emplace_back(target, sectionBit);
+					else
+						it->second |= sectionBit;
 				}
 			}
 		}
 
-		// Move remeshing candidates in the processing queue
+		// a chunk in the pipeline may have read its octree before the edit, it's remeshed again once it's uploaded
+		std::vector<std::pair<Chunk*, uint8_t>> inPipeline;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex);
+			for (auto &[target, sectionMask] : touched) {
+				if (target->stage == CHUNK_STAGE_UPLOADED)
+					markSectionsDirty(target, sectionMask);
+				else
+					inPipeline.emplace_back(target, sectionMask);
+			}
+		}
+		for (auto &[target, sectionMask] : inPipeline)
+			spawn(remeshOnceUploaded(target, sectionMask));
+	}
+
+	Task<> EveTerrain::remeshOnceUploaded(Chunk *chunk, uint8_t sectionMask) {
+		unsigned int generation = resetCount;
+		if (!co_await chunk->reached(CHUNK_STAGE_UPLOADED) || generation != resetCount)
+			co_return;
+
+		boost::lock_guard<boost::mutex> lock(mutex);
+		markSectionsDirty(chunk, sectionMask);
+	}
+
+	void EveTerrain::markSectionsDirty(Chunk *chunk, uint8_t sectionMask) {
+		// a meshing job already running for the chunk leaves the bits for the next one
+		chunk->dirtySections |= sectionMask;
+		if (std::find(remeshingCandidates.begin(), remeshingCandidates.end(), chunk) == remeshingCandidates.end())
+			remeshingCandidates.push_back(chunk);
+	}
+
+	bool EveTerrain::raycastVoxel(glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3 &hit) {
+		EASY_FUNCTION(profiler::colors::Magenta);
+		// cell by cell along the ray, the next boundary crossed is the closest of the three axes
+		glm::ivec3 cell = glm::ivec3(glm::floor(origin));
+		glm::ivec3 step(0);
+		glm::vec3 next(std::numeric_limits<float>::infinity());
+		glm::vec3 delta(std::numeric_limits<float>::infinity());
+		for (int axis = 0; axis < 3; axis++) {
+			if (direction[axis] == 0.f)
+				continue;
+			step[axis] = direction[axis] > 0.f ? 1 : -1;
+			delta[axis] = std::abs(1.f / direction[axis]);
+			next[axis] = (direction[axis] > 0.f ? float(cell[axis] + 1) - origin[axis] : origin[axis] - float(cell[axis])) * delta[axis];
+		}
+
+		float distance = 0.f;
+		while (distance <= maxDistance) {
+			if (Chunk *chunk = findContainerChunkAt(cell)) {
+				boost::lock_guard<boost::mutex> lock(chunk->mutex);
+				Octant *octant = chunk->root->getSmallestContainerAt(glm::vec3(cell) + .5f);
+				if (octant && octant->voxel && octant->voxel->isOpaque()) {
+					hit = cell;
+					return true;
+				}
+			}
+
+			int axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+			distance = next[axis];
+			next[axis] += delta[axis];
+			cell[axis] += step[axis];
+		}
+		return false;
+	}
+
+	void EveTerrain::tick(float deltaTime, glm::vec3 cameraPosition) {
+		EASY_FUNCTION(profiler::colors::Magenta);
+		EASY_BLOCK("Terrain Tick");
+
+		frameCount++;
+		releaseRetiredModels();
+		// sorted by updateChunks during the last frame
+		translucentChunks.swap(sortedTranslucentChunks);
+
+		// the octant meshing draws eveCube, nothing is meshed before it's loaded
+		if (!eveCube)
+			return;
+
+		// Take the chunks finished by the workers, they wait in the integration queue until there's frame time for them
+		{
+			boost::lock_guard<boost::mutex> lock(mutex);
+			for (Chunk *chunk : remeshingProcessed) {
+				if (chunk && chunk->id && std::find(integrationQueue.begin(), integrationQueue.end(), chunk) == integrationQueue.end())
+					integrationQueue.push_back(chunk);
+			}
+			remeshingProcessed.clear();
+		}
+
+		// Upload them closest first until the frame budget is spent, the rest is deferred to the next frames
+		// (at least one chunk goes through every frame so the queue always drains)
+		{
+			EASY_BLOCK("Integrate chunks");
+			std::sort(integrationQueue.begin(), integrationQueue.end(), [&cameraPosition](Chunk *a, Chunk *b) {
+				glm::vec3 da = glm::vec3(a->position) - cameraPosition;
+				glm::vec3 db = glm::vec3(b->position) - cameraPosition;
+				return glm::dot(da, da) < glm::dot(db, db);
+			});
+
+			auto start = std::chrono::high_resolution_clock::now();
+			size_t integrated = 0;
+			for (Chunk *chunk : integrationQueue) {
+				float elapsedMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+				if (integrated > 0 && elapsedMs >= integrationBudgetMs)
+					break;
+
+				integrateChunk(chunk, cameraPosition);
+				integrated++;
+			}
+			integrationQueue.erase(integrationQueue.begin(), integrationQueue.begin() + integrated);
+		}
+
+		// Move remeshing candidates in the processing queue, as long as the pending meshes fit in memory
+		// (the ones updateChunks asked for during the last frame included)
 		{
 			boost::lock_guard<boost::mutex> lock(mutex);
-			for (auto it = remeshingCandidates.begin(); it != remeshingCandidates.end();) {
+			for (auto it = remeshingCandidates.begin(); it != remeshingCandidates.end() && !isMeshingSaturated();) {
 				Chunk *chunk = *it;
-				remeshingProcessing.push_back(*it);
-				meshingPool.pushChunkToRemeshingQueue(*it);
-				remeshingCandidates.erase(std::find(remeshingCandidates.begin(), remeshingCandidates.end(), *it));
+				// one meshing job per chunk at a time, edits made meanwhile wait for the next one
+				// (the collider jobs touch the same bodies and the cap jobs the same caps, they wait as well)
+				if (std::find(remeshingProcessing.begin(), remeshingProcessing.end(), chunk) != remeshingProcessing.end()
+					|| std::find(colliderProcessing.begin(), colliderProcessing.end(), chunk) != colliderProcessing.end()
+					|| std::find(capProcessing.begin(), capProcessing.end(), chunk) != capProcessing.end()) {
+					it++;
+					continue;
+				}
+				// read by the job, updateChunkColliders holds the changes made meanwhile back until it is done
+				chunk->collidersWanted = !lazyColliders || isNearDynamicBody(*chunk);
+				remeshingProcessing.push_back(chunk);
+				chunkPool.pushChunkToRemeshingQueue(chunk);
+				it = remeshingCandidates.erase(it);
 			}
 		}
 
@@ -164,6 +418,9 @@ namespace eve {
 				if (*it) {
 					if (chunk->id) {
 						chunk->isQueued = true;
+						// meshed at its lod right away, not swapped right after
+						if (lodEnabled && meshingMode == MESHING_GREEDY)
+							chunk->lod = getLodForDistance(glm::distance(glm::vec3(chunk->position), cameraPosition), chunk->lod);
 						remeshingCandidates.push_back(*it);
 						noisingProcessed.erase(std::find(noisingProcessed.begin(), noisingProcessed.end(), *it));
 					}
@@ -171,45 +428,292 @@ namespace eve {
 			}
 		}
 
-		for (auto it = noisingCandidates.begin(); it != noisingCandidates.end();) {
-			Chunk *chunk = *it;
-			if (*it) {
-				if (chunk->id) {
+		// New noise jobs are held back while the meshing side is saturated, noised chunks would just pile up
+		{
+			boost::lock_guard<boost::mutex> lock(mutex);
+			while (!noisingCandidates.empty() && !isNoisingSaturated()) {
+				Chunk *chunk = noisingCandidates.front();
+				if (chunk && chunk->id) {
 					chunk->isQueued = true;
-					noisingProcessing.push_back(*it);
-					//noisingPool.pushChunkToNoisingQueue(*it);
-					meshingPool.pushChunkToNoisingQueue(*it);
-					noisingCandidates.erase(std::find(noisingCandidates.begin(), noisingCandidates.end(), *it));
+					noisingProcessing.push_back(chunk);
+					chunkPool.pushChunkToNoisingQueue(chunk);
 				}
+				noisingCandidates.erase(noisingCandidates.begin());
 			}
 		}
 
 		if (shouldReset_) {
 			shouldReset_ = false;
+			resetCount++;
+			// in-flight jobs reference the chunks we're about to destroy
+			chunkPool.destroy();
+
+			// the chunks still in the pipeline have bodies too (the voxel shape comes with the first remesh)
+			std::unordered_set<Chunk*> chunks;
+			for (auto it : chunkMap)
+				chunks.insert(it.second);
+			for (std::vector<Chunk*> *queue : {&noisingCandidates, &noisingProcessing, &noisingProcessed, &remeshingCandidates,
+				&remeshingProcessing, &remeshingProcessed, &colliderProcessing, &capProcessing, &integrationQueue})
+				for (Chunk *chunk : *queue)
+					if (chunk)
+						chunks.insert(chunk);
+
+			noisingCandidates.clear();
+			noisingProcessing.clear();
+			noisingProcessed.clear();
 			remeshingCandidates.clear();
 			remeshingProcessing.clear();
 			remeshingProcessed.clear();
+			colliderProcessing.clear();
+			capProcessing.clear();
+			integrationQueue.clear();
+			translucentChunks.clear();
+			sortedTranslucentChunks.clear();
 			vkDeviceWaitIdle(eveDevice.device());
-			for (auto it : chunkMap)
-				it.second->~Chunk();
+			for (Chunk *chunk : chunks)
+				chunk->~Chunk();
 			chunkMap.clear();
 			init();
 		}
 
 		if (shouldRemesh_) {
 			shouldRemesh_ = false;
-			remeshingCandidates.clear();
-			remeshingProcessing.clear();
-			remeshingProcessed.clear();
-			meshingPool.meshingMode = meshingMode;
-			for (auto kv : chunkMap) {
-				Chunk *chunk = kv.second;
-				chunk->isQueued = true;
+			boost::lock_guard<boost::mutex> lock(mutex);
+			// the octant mode draws cubes instead of section meshes, a mode change can't swap them in place
+			bool modeChanged = chunkPool.meshingMode != meshingMode;
+			chunkPool.meshingMode = meshingMode;
+
+			// the queues are left alone: running jobs hold their chunk (one job per chunk), the meshed ones still
+			// have to be integrated. Every chunk meshed or being meshed gets a new mesh after that.
+			std::vector<Chunk*> meshed;
+			for (auto kv : chunkMap)
+				meshed.push_back(kv.second);
+			meshed.insert(meshed.end(), remeshingProcessing.begin(), remeshingProcessing.end());
+			meshed.insert(meshed.end(), remeshingProcessed.begin(), remeshingProcessed.end());
+			meshed.insert(meshed.end(), integrationQueue.begin(), integrationQueue.end());
+			for (Chunk *chunk : meshed) {
+				if (!chunk || std::find(remeshingCandidates.begin(), remeshingCandidates.end(), chunk) != remeshingCandidates.end())
+					continue;
+				// otherwise the current meshes stay drawn until the new ones are integrated
+				if (modeChanged)
+					chunk->isQueued = true;
+				chunk->dirtySections = Chunk::ALL_SECTIONS;
+				remeshingCandidates.push_back(chunk);
+			}
+		}
+	}
+
+	void EveTerrain::updateChunks(glm::vec3 cameraPosition) {
+		EASY_FUNCTION(profiler::colors::Magenta);
+		if (!eveCube)
+			return;
+
+		// the chunks asked for here are dispatched by the next tick
+		{
+			boost::lock_guard<boost::mutex> lock(mutex);
+			updateChunkLods(cameraPosition);
+			updateChunkColliders();
+			updateChunkCaps();
+		}
+		sortTranslucentChunks(cameraPosition);
+	}
+
+	int EveTerrain::getLodForDistance(float distance, int currentLod) const {
+		int lod = 0;
+		// crossing ring n outward needs the hysteresis on top of the distance, crossing it back inward as much below
+		while (lod < Chunk::MAX_LOD && distance >= lodDistances[lod] + (currentLod <= lod ? lodHysteresis : -lodHysteresis))
+			lod++;
+		return lod;
+	}
+
+	void EveTerrain::updateChunkLods(glm::vec3 cameraPosition) {
+		EASY_BLOCK("Update chunk lods");
+		for (auto &kv : chunkMap) {
+			Chunk *chunk = kv.second;
+			// chunks in the pipeline pick their lod up with their next full mesh
+			if (chunk->isQueued || chunk->stage != CHUNK_STAGE_UPLOADED)
+				continue;
+
+			int lod = 0;
+			if (lodEnabled && meshingMode == MESHING_GREEDY)
+				lod = getLodForDistance(glm::distance(glm::vec3(chunk->position), cameraPosition), chunk->lod);
+			if (lod == chunk->lod)
+				continue;
+
+			// the previous lod stays drawn until the new mesh is integrated
+			chunk->lod = lod;
+			markSectionsDirty(chunk, Chunk::ALL_SECTIONS);
+
+			// the neighbors halo holds our cells at our lod, their border sections follow
+			for (int side = 0; side < 6; side++) {
+				Chunk *neighbor = chunk->neighbors[side];
+				if (neighbor && !neighbor->isQueued && neighbor->stage == CHUNK_STAGE_UPLOADED)
+					markSectionsDirty(neighbor, Chunk::getSideSections(side ^ 1));
+			}
+		}
+	}
+
+	void EveTerrain::setDynamicBounds(uint32_t stateIndex, const AABox &bounds) {
+		// the chunk cells the bounds overlap, back in render space (y down)
+		glm::vec3 low(bounds.mMin.GetX(), -bounds.mMax.GetY(), bounds.mMin.GetZ());
+		glm::vec3 high(bounds.mMax.GetX(), -bounds.mMin.GetY(), bounds.mMax.GetZ());
+		glm::ivec3 minCell = glm::ivec3(glm::ceil((low - float(CHUNK_SIZE / 2)) / float(CHUNK_SIZE)));
+		glm::ivec3 maxCell = glm::ivec3(glm::floor((high + float(CHUNK_SIZE / 2)) / float(CHUNK_SIZE)));
+
+		if (dynamicCellRanges.size() <= stateIndex)
+			dynamicCellRanges.resize(stateIndex + 1, {glm::ivec3(1), glm::ivec3(0)});
+		auto &range = dynamicCellRanges[stateIndex];
+		if (range.first == minCell && range.second == maxCell)
+			return;
+
+		auto forEachCell = [](glm::ivec3 min, glm::ivec3 max, auto &&function) {
+			for (int x = min.x; x <= max.x; x++)
+				for (int y = min.y; y <= max.y; y++)
+					for (int z = min.z; z <= max.z; z++)
+						function(glm::ivec3(x, y, z));
+		};
+		// only the cells getting their first body or losing their last one change anything
+		forEachCell(range.first, range.second, [this](glm::ivec3 cell) {
+			auto it = dynamicCells.find(cell);
+			if (--it->second == 0) {
+				dynamicCells.erase(it);
+				colliderCellsChanged.insert(cell);
+			}
+		});
+		forEachCell(minCell, maxCell, [this](glm::ivec3 cell) {
+			if (++dynamicCells[cell] == 1)
+				colliderCellsChanged.insert(cell);
+		});
+		range = {minCell, maxCell};
+	}
+
+	bool EveTerrain::isNearDynamicBody(const Chunk &chunk) const {
+		return dynamicCells.count(chunk.position / CHUNK_SIZE) > 0;
+	}
+
+	void EveTerrain::updateChunkColliders() {
+		EASY_BLOCK("Update chunk colliders");
+		// switching the lazy colliders changes every chunk
+		if (lazyColliders != lazyCollidersApplied) {
+			lazyCollidersApplied = lazyColliders;
+			for (auto &kv : chunkGrid)
+				colliderCellsChanged.insert(kv.first);
+		}
+
+		for (auto it = colliderCellsChanged.begin(); it != colliderCellsChanged.end();) {
+			auto found = chunkGrid.find(*it);
+			if (found == chunkGrid.end()) {
+				it = colliderCellsChanged.erase(it);
+				continue;
+			}
+
+			Chunk *chunk = found->second;
+			bool wanted = !lazyColliders || isNearDynamicBody(*chunk);
+			if (wanted == chunk->collidersWanted) {
+				it = colliderCellsChanged.erase(it);
+				continue;
+			}
+
+			// a running job read the flag already, the change waits until it's done
+			// (a chunk meshed for the first time waits for its integration as well)
+			if (std::find(remeshingProcessing.begin(), remeshingProcessing.end(), chunk) != remeshingProcessing.end()
+				|| std::find(colliderProcessing.begin(), colliderProcessing.end(), chunk) != colliderProcessing.end()
+				|| chunk->stage == CHUNK_STAGE_MESHED) {
+				it++;
+				continue;
+			}
+			it = colliderCellsChanged.erase(it);
+			chunk->collidersWanted = wanted;
+
+			// chunks not meshed yet or waiting for a remesh build theirs with the mesh
+			if (chunk->stage < CHUNK_STAGE_MESHED || std::find(remeshingCandidates.begin(), remeshingCandidates.end(), chunk) != remeshingCandidates.end())
+				continue;
+
+			// the octant boxes come out of the meshers
+			if (wanted && colliderMode == COLLIDER_BOXES) {
+				chunk->dirtySections = Chunk::ALL_SECTIONS;
 				remeshingCandidates.push_back(chunk);
+				continue;
 			}
+			colliderProcessing.push_back(chunk);
+			chunkPool.pushChunkToColliderQueue(chunk);
 		}
 	}
 
+	void EveTerrain::updateChunkCaps() {
+		EASY_BLOCK("Update chunk caps");
+		if (!cutEnabled)
+			return;
+
+		for (auto &kv : chunkMap) {
+			Chunk *chunk = kv.second;
+			int layer = getCutLayer(*chunk);
+			// chunks in the pipeline get the caps of their layer with their mesh
+			if (layer < 0 || chunk->isQueued || chunk->stage != CHUNK_STAGE_UPLOADED
+				|| std::find(remeshingCandidates.begin(), remeshingCandidates.end(), chunk) != remeshingCandidates.end()
+				|| std::find(remeshingProcessing.begin(), remeshingProcessing.end(), chunk) != remeshingProcessing.end()
+				|| std::find(capProcessing.begin(), capProcessing.end(), chunk) != capProcessing.end())
+				continue;
+
+			{
+				boost::lock_guard<boost::mutex> chunkLock(chunk->mutex);
+				if (chunk->capLayer == layer)
+					continue;
+			}
+			capProcessing.push_back(chunk);
+			chunkPool.pushChunkToCapQueue(chunk);
+		}
+	}
+
+	void EveTerrain::sortTranslucentChunks(glm::vec3 cameraPosition) {
+		EASY_BLOCK("Sort translucent chunks");
+		sortedTranslucentChunks.clear();
+
+		for (auto &kv : chunkMap) {
+			Chunk *chunk = kv.second;
+			if (chunk->isQueued)
+				continue;
+
+			boost::lock_guard<boost::mutex> lock(chunk->mutex);
+			// a new mesh waiting for its integration is sorted there, the previous model is drawn until then
+			if (!chunk->uploadTranslucent && !chunk->translucentQuads.empty()) {
+				if (!chunk->resortTranslucent) {
+					uint8_t sides = chunk->getVisibleSides(cameraPosition);
+					// every side is visible from inside the chunk, there the eye itself has to move
+					bool inside = sides == 0x3F;
+					chunk->resortTranslucent = sides != chunk->translucentSides
+						|| (inside && glm::distance(cameraPosition, chunk->translucentEye) >= translucentResortDistance);
+				}
+				// queued again if a remesh request cleared the queue meanwhile
+				if (chunk->resortTranslucent && std::find(integrationQueue.begin(), integrationQueue.end(), chunk) == integrationQueue.end())
+					integrationQueue.push_back(chunk);
+			}
+
+			if (chunk->translucentModel)
+				sortedTranslucentChunks.push_back(chunk);
+		}
+
+		std::sort(sortedTranslucentChunks.begin(), sortedTranslucentChunks.end(), [&cameraPosition](Chunk *a, Chunk *b) {
+			glm::vec3 da = glm::vec3(a->position) - cameraPosition;
+			glm::vec3 db = glm::vec3(b->position) - cameraPosition;
+			return glm::dot(da, da) > glm::dot(db, db);
+		});
+	}
+
+	void EveTerrain::rebuildTranslucentModel(Chunk *chunk, glm::vec3 eye) {
+		EASY_FUNCTION(profiler::colors::Magenta);
+		chunk->translucentSides = chunk->getVisibleSides(eye);
+		chunk->translucentEye = eye;
+		retireModel(std::move(chunk->translucentModel));
+		chunk->translucentModel.reset();
+		if (chunk->translucentQuads.empty())
+			return;
+
+		EveModel::Builder builder;
+		chunk->sortTranslucent(eye, builder, chunkRenderMode == CHUNK_RENDER_FACES);
+		chunk->translucentModel = uploadModel(builder);
+	}
+
 	/*bool EveTerrain::isFullSolid(Octant *octant) {
 		if (octant) {
 			if (octant->isAllSame && octant->voxel->id == 0) return false;
@@ -318,7 +822,7 @@ namespace eve {
 					// this part of code represent a problem because we imply a filling type of voxel and we erase everything on our path
 					// (fixme)
 					int childWidth = node->width / 2;
-					node->octants[i] = new Octant((node->position + glm::vec3(octreeOffsets[i] * childWidth) / 2), childWidth, node->container, node);
+					node->octants[i] = new Octant(node->position + getOctreeOffset(i) * float(childWidth) / 2.f, childWidth, node->container, node);
 				}
 			}
 		}
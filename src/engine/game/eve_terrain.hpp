@@ -19,6 +19,9 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
 #include <easy/profiler.h>
 
 #include "../utils/eve_threads.hpp"
@@ -28,10 +31,15 @@ namespace eve {
 	class EveDebug;
 	class EveTerrain {
 		public:
-			EveTerrain(EveDevice &device, EvePhysx &physx);
+			EveTerrain(EveDevice &device, EvePhysx &physx, EveScheduler &scheduler);
 			~EveTerrain();
 
-			void tick(float deltaTime);
+			void tick(float deltaTime, glm::vec3 cameraPosition);
+			// lods, colliders, caps and translucent sort of the chunk map, on a worker after tick while the frame is recorded
+			// (nothing drawn this frame is changed, the chunks it queues are dispatched by the next tick)
+			void updateChunks(glm::vec3 cameraPosition);
+			// uploads what the workers built for the chunk and sorts its translucent faces from the camera if asked
+			void integrateChunk(Chunk *chunk, glm::vec3 cameraPosition);
 
 			EveTerrain(const EveTerrain&) = delete;
 			EveTerrain &operator=(const EveTerrain&) = delete;
@@ -39,6 +47,15 @@ namespace eve {
 			//Octant queryTerrain(Octant *node, int depth, glm::ivec3 queryPoint);
 
 			Chunk *findContainerChunkAt(glm::ivec3 pos);
+
+			/*
+			* Voxel edit at a world cell, only the touched chunk sections (neighbor chunks included) are remeshed.
+			* It's applied once the chunk is noised, sections of chunks still in the pipeline are remeshed again once they're uploaded
+			* (their running job may have read the octree before the edit).
+			*/
+			bool setVoxelAt(glm::ivec3 pos, EveVoxel *voxel);
+			// first opaque cell hit along the ray (world cells, cell n covers [n, n + 1)), main thread
+			bool raycastVoxel(glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3 &hit);
 			//Octant* changeOctantTerrain(Octant *node, glm::ivec3 queryPoint, EveVoxel *voxel);
 
 			void onMouseWheel(GLFWwindow *window, double xoffset, double yoffset);
@@ -54,19 +71,25 @@ namespace eve {
 
 			EveDevice &eveDevice;
 			EvePhysx &evePhysx;
+			EveScheduler &eveScheduler;
 
+			// indexed with the voxel id, the ids follow the texture order of EveRenderer (texture = id - 1)
 			std::vector<EveVoxel*> voxelMap;
+			bool isTranslucent(uint16_t type) const { return type < voxelMap.size() && voxelMap[type]->translucent; }
 			unsigned int chunkCount = 0;
 			std::map<unsigned int, Chunk*> chunkMap;
 			std::map<unsigned int, BodyID*> physxMap;
 
 			EveTerrainMeshingMode meshingMode = MESHING_CHUNK;
+			EveChunkRenderMode chunkRenderMode = CHUNK_RENDER_VERTICES;
+			EveChunkColliderMode colliderMode = COLLIDER_VOXEL_SHAPE;
 
-			std::shared_ptr<EveModel> eveCube = EveModel::createModelFromFile(eveDevice, "gamedata/core/models/cube.obj", glm::vec3(1, 0, 0));
-			std::shared_ptr<EveModel> eveQuad = EveModel::createModelFromFile(eveDevice, "gamedata/core/models/quad.obj", glm::vec3(1));
-			std::shared_ptr<EveModel> eveQuadR = EveModel::createModelFromFile(eveDevice, "gamedata/core/models/quad.obj", glm::vec3(1, 0, 0));
-			std::shared_ptr<EveModel> eveQuadG = EveModel::createModelFromFile(eveDevice, "gamedata/core/models/quad.obj", glm::vec3(0, 1, 0));
-			std::shared_ptr<EveModel> eveQuadB = EveModel::createModelFromFile(eveDevice, "gamedata/core/models/quad.obj", glm::vec3(0, 0, 1));
+			// loaded in the background by loadModels(), null until then (the terrain doesn't tick before)
+			std::shared_ptr<EveModel> eveCube;
+			std::shared_ptr<EveModel> eveQuad;
+			std::shared_ptr<EveModel> eveQuadR;
+			std::shared_ptr<EveModel> eveQuadG;
+			std::shared_ptr<EveModel> eveQuadB;
 
 			//std::vector<Chunk> refinementCandidates;
 			//std::vector<Chunk> refinementProcessed;
@@ -81,22 +104,55 @@ namespace eve {
 			std::vector<Chunk*> remeshingProcessing;
 			std::vector<Chunk*> remeshingProcessed;
 
+			// meshes replaced by a newer one are kept until the frames in flight that may draw them are done
+			// (any thread, the workers retire the meshes of the chunks they hide)
+			void retireModel(std::shared_ptr<EveModel> model);
+			// the models above, read and parsed on the background lane
+			Task<> loadModels();
+			// chunk models are uploaded without waiting for the gpu (main thread)
+			std::shared_ptr<EveModel> uploadModel(const EveModel::Builder &builder);
+			std::atomic<uint64_t> frameCount{0};
+
+			// chunks meshed by the workers waiting for their gpu upload (main thread only)
+			std::vector<Chunk*> integrationQueue;
+			float integrationBudgetMs = 4.f;
+
+			// lod rings: from lodDistances[n] on (camera to chunk center) the chunks are meshed at lod n + 1
+			bool lodEnabled = true;
+			float lodDistances[Chunk::MAX_LOD] = {48.f, 96.f, 160.f};
+			float lodHysteresis = 8.f; // a chunk moves to the next ring that much past its border, so it doesn't flicker between two
+			int getLodForDistance(float distance, int currentLod) const;
+
+			/*
+			* Colliders are only built for the chunks around the dynamic bodies: their bounds, swept over colliderLookahead
+			* seconds of their velocity and grown by colliderMargin, are handed by the world when the body moves (physics space).
+			* Each body covers a box of chunk cells, the cells count the bodies over them and only the cells
+			* getting their first body or losing their last one are looked at by updateChunkColliders.
+			* The chunks leaving the range release their colliders, lazyColliders off gives every chunk its colliders.
+			* */
+			bool lazyColliders = true;
+			float colliderMargin = 4.f;
+			float colliderLookahead = .5f;
+			void setDynamicBounds(uint32_t stateIndex, const AABox &bounds);
+			std::vector<Chunk*> colliderProcessing; // chunks running Chunk::updateColliders (terrain mutex)
+			bool isNearDynamicBody(const Chunk &chunk) const;
+
 			std::vector<Chunk*> noisingCandidates;
 			std::vector<Chunk*> noisingProcessing;
 			std::vector<Chunk*> noisingProcessed;
 
-			//bool needRebuild = false;
+			// backpressure: producers hold back new jobs while downstream stages are saturated
+			// (the getters read the queues, call them with the terrain mutex held)
+			size_t getInFlightJobs() const;
+			size_t getMeshingBacklog() const;
+			bool isMeshingSaturated() const;
+			bool isNoisingSaturated() const;
 
-			std::vector<glm::ivec3> octreeOffsets = {
-				glm::ivec3(-1, -1, -1),	// left		   top		near
-				glm::ivec3(-1, -1, 1),	// left		   top		far
-				glm::ivec3(1, -1, -1),	// right	   top		near
-				glm::ivec3(1, -1, 1),	// right	   top		far
-				glm::ivec3(-1, 1, -1),	// left		   bot		near
-				glm::ivec3(-1, 1, 1),	// left		   bot		far
-				glm::ivec3(1, 1, -1),	// right	   bot		near
-				glm::ivec3(1, 1, 1)		// right	   bot		far
-			};
+			int maxInFlightJobs = 64;
+			size_t maxPendingMeshBytes = 256 * 1024 * 1024;
+			std::atomic<size_t> pendingMeshBytes{0};
+
+			//bool needRebuild = false;
 
 			siv::PerlinNoise::seed_type seed = 123456u;
 			siv::PerlinNoise perlin{seed};
@@ -105,12 +161,58 @@ namespace eve {
 			int maxHeight = -48;
 			int minHeight = 48;
 
+			// cut view: everything above playerCurrentLevel (smaller y) is discarded by the shaders, chunk caps close the cut
+			// (toggled from the debug menu, the mouse wheel moves the level)
 			int playerCurrentLevel = 0;
+			bool cutEnabled = false;
+			std::vector<Chunk*> capProcessing; // chunks running Chunk::updateCaps (terrain mutex)
+			// layer of the chunk the cut goes through (chunk corner space), -1 when the chunk isn't cut
+			int getCutLayer(const Chunk &chunk) const;
+			// the whole chunk is discarded by the cut, it isn't drawn at all
+			bool isAboveCut(const Chunk &chunk) const { return cutEnabled && chunk.position.y + CHUNK_SIZE / 2 < playerCurrentLevel; }
+
+			// uploaded chunks with translucent faces, back to front from the camera (sorted by updateChunks, swapped in by the next tick)
+			std::vector<Chunk*> translucentChunks;
+			float translucentResortDistance = 1.f; // the chunk the camera is in gets sorted again once the eye moved that much
 
 		private:
-			EveThreadPool noisingPool{8};
-			EveThreadPool meshingPool{8};
+			void releaseRetiredModels();
+			boost::mutex retiredModelsMutex;
+			std::vector<std::pair<std::shared_ptr<EveModel>, uint64_t>> retiredModels; // model, frame it got retired
+
+			// requeues the uploaded chunks whose lod ring changed (terrain mutex held)
+			void updateChunkLods(glm::vec3 cameraPosition);
+			// flags the chunks getting in or out of the dynamic bodies range and builds or releases their colliders (terrain mutex held)
+			void updateChunkColliders();
+			// asks for new caps for the uploaded chunks the cut moved to another layer of (terrain mutex held)
+			void updateChunkCaps();
+			// queues the chunks the camera crossed a plane of (or moved in) for a new sort and fills sortedTranslucentChunks
+			void sortTranslucentChunks(glm::vec3 cameraPosition);
+			// written by updateChunks while translucentChunks is drawn
+			std::vector<Chunk*> sortedTranslucentChunks;
+
+			// [chunk cell], every chunk of the terrain (filled by init)
+			std::unordered_map<glm::ivec3, Chunk*> chunkGrid;
+			// [physics state index], cells covered by the body bounds (min, max), empty when min > max
+			std::vector<std::pair<glm::ivec3, glm::ivec3>> dynamicCellRanges;
+			// [chunk cell], bodies over the cell
+			std::unordered_map<glm::ivec3, unsigned int> dynamicCells;
+			// cells whose chunk may have to change its colliders, kept while a running job holds the chunk
+			std::unordered_set<glm::ivec3> colliderCellsChanged;
+			bool lazyCollidersApplied = true;
+			// translucentModel from the translucent faces sorted back to front from the eye (chunk mutex held)
+			void rebuildTranslucentModel(Chunk *chunk, glm::vec3 eye);
+
+			// edits run on the main lane, across frames when a chunk has to reach a stage first
+			Task<> applyVoxelEdit(Chunk *chunk, glm::ivec3 cell, EveVoxel *voxel);
+			Task<> remeshOnceUploaded(Chunk *chunk, uint8_t sectionMask);
+			// queues the sections for a remesh (terrain mutex held)
+			void markSectionsDirty(Chunk *chunk, uint8_t sectionMask);
+
+			EveThreadPool chunkPool;
 			
+			// bumped by every reset, an edit resumed after one doesn't touch its (freed) chunks
+			unsigned int resetCount = 0;
 			bool shouldReset_ = false;
 			bool shouldRemesh_ = false;
 	};
@@ -0,0 +1,348 @@
+#include "eve_voxel_shape.hpp"
+
+#include <Jolt/Physics/Collision/CollisionDispatch.h>
+#include <Jolt/Physics/Collision/CollidePointResult.h>
+#include <Jolt/Physics/Collision/CastResult.h>
+#include <Jolt/Physics/Collision/RayCast.h>
+#include <Jolt/Physics/Collision/ShapeFilter.h>
+#include <Jolt/Physics/Collision/TransformedShape.h>
+#include <Jolt/Physics/Collision/Shape/ScaleHelpers.h>
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+
+namespace eve {
+	// sides in the chunk neighbor order (top, down, left, right, near, far), local space (y up)
+	// u x v is the normal, the face corners go counter clockwise seen from outside
+	static constexpr int SIDE_NORMALS[6][3] = {{0, 1, 0}, {0, -1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 0, 1}};
+	static constexpr int SIDE_U[6][3] = {{0, 0, 1}, {1, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 0}, {1, 0, 0}};
+	static constexpr int SIDE_V[6][3] = {{1, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 0, 1}, {1, 0, 0}, {0, 1, 0}};
+
+	static Vec3 toVec3(const int v[3]) { return Vec3(float(v[0]), float(v[1]), float(v[2])); }
+
+	RefConst<Shape> EveVoxelShape::sCellBox;
+
+	EveVoxelShape::EveVoxelShape() : Shape(EShapeType::User1, EShapeSubType::User1) {
+		for (std::atomic<uint16_t> &column : columns)
+			column.store(0, std::memory_order_relaxed);
+	}
+
+	void EveVoxelShape::sRegister() {
+		sCellBox = new BoxShape(Vec3::sReplicate(.5f));
+
+		for (EShapeSubType subType : sConvexSubShapeTypes) {
+			CollisionDispatch::sRegisterCollideShape(subType, EShapeSubType::User1, sCollideConvexVsVoxels);
+			CollisionDispatch::sRegisterCastShape(subType, EShapeSubType::User1, sCastConvexVsVoxels);
+
+			CollisionDispatch::sRegisterCollideShape(EShapeSubType::User1, subType, CollisionDispatch::sReversedCollideShape);
+			CollisionDispatch::sRegisterCastShape(EShapeSubType::User1, subType, CollisionDispatch::sReversedCastShape);
+		}
+	}
+
+	void EveVoxelShape::setSolid(int x, int y, int z, bool solid) {
+		uint16_t bit = uint16_t(1 << y);
+		if (solid)
+			columns[x + z * SIZE].fetch_or(bit, std::memory_order_relaxed);
+		else
+			columns[x + z * SIZE].fetch_and(uint16_t(~bit), std::memory_order_relaxed);
+	}
+
+	bool EveVoxelShape::getCellRange(const AABox &bounds, CellRange &outRange) {
+		// grid space: the cells are unit cubes from 0 to SIZE, y down
+		float lo[3] = {bounds.mMin.GetX() + SIZE / 2, SIZE / 2 - bounds.mMax.GetY(), bounds.mMin.GetZ() + SIZE / 2};
+		float hi[3] = {bounds.mMax.GetX() + SIZE / 2, SIZE / 2 - bounds.mMin.GetY(), bounds.mMax.GetZ() + SIZE / 2};
+
+		for (int axis = 0; axis < 3; axis++) {
+			if (hi[axis] < 0.f || lo[axis] > SIZE)
+				return false;
+			outRange.min[axis] = std::clamp(int(std::floor(lo[axis])), 0, SIZE - 1);
+			outRange.max[axis] = std::clamp(int(std::floor(hi[axis])), 0, SIZE - 1);
+		}
+		return true;
+	}
+
+	bool EveVoxelShape::castRay(Vec3Arg origin, Vec3Arg direction, float maxFraction, bool solidStart, bool backFaces, float &outFraction, int &outCell) const {
+		float o[3] = {origin.GetX() + SIZE / 2, SIZE / 2 - origin.GetY(), origin.GetZ() + SIZE / 2};
+		float d[3] = {direction.GetX(), -direction.GetY(), direction.GetZ()};
+
+		// clip the ray to the chunk
+		float enter = 0.f;
+		float exit = maxFraction;
+		for (int axis = 0; axis < 3; axis++) {
+			if (d[axis] == 0.f) {
+				if (o[axis] < 0.f || o[axis] > SIZE)
+					return false;
+				continue;
+			}
+			float t0 = -o[axis] / d[axis];
+			float t1 = (SIZE - o[axis]) / d[axis];
+			if (t0 > t1)
+				std::swap(t0, t1);
+			enter = std::max(enter, t0);
+			exit = std::min(exit, t1);
+		}
+		if (enter > exit || enter >= maxFraction)
+			return false;
+
+		// then walk the cells it crosses, in order
+		int cell[3], step[3];
+		float next[3], delta[3];
+		for (int axis = 0; axis < 3; axis++) {
+			float p = o[axis] + d[axis] * enter;
+			// a ray on a cell boundary is in the cell it moves into
+			int c = d[axis] < 0.f ? int(std::ceil(p)) - 1 : int(std::floor(p));
+			cell[axis] = std::clamp(c, 0, SIZE - 1);
+
+			if (d[axis] > 0.f) {
+				step[axis] = 1;
+				next[axis] = (cell[axis] + 1 - o[axis]) / d[axis];
+				delta[axis] = 1.f / d[axis];
+			}
+			else if (d[axis] < 0.f) {
+				step[axis] = -1;
+				next[axis] = (cell[axis] - o[axis]) / d[axis];
+				delta[axis] = -1.f / d[axis];
+			}
+			else {
+				step[axis] = 0;
+				next[axis] = FLT_MAX;
+				delta[axis] = FLT_MAX;
+			}
+		}
+
+		float t = enter;
+		// the origin is in the first cell only when the ray starts inside the chunk
+		bool start = enter == 0.f;
+		for (;;) {
+			int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+			if (isSolid(cell[0], cell[1], cell[2])) {
+				if (!start || solidStart) {
+					outFraction = t;
+					outCell = getCellIndex(cell[0], cell[1], cell[2]);
+					return true;
+				}
+				// hollow start cell, the ray leaves it through a back face
+				if (backFaces && next[axis] < maxFraction) {
+					outFraction = next[axis];
+					outCell = getCellIndex(cell[0], cell[1], cell[2]);
+					return true;
+				}
+			}
+			start = false;
+
+			t = next[axis];
+			cell[axis] += step[axis];
+			if (t >= exit || cell[axis] < 0 || cell[axis] >= SIZE)
+				return false;
+			next[axis] += delta[axis];
+		}
+	}
+
+	Vec3 EveVoxelShape::GetSurfaceNormal(const SubShapeID &inSubShapeID, Vec3Arg inLocalSurfacePosition) const {
+		SubShapeID remainder;
+		int cell = int(inSubShapeID.PopID(SUB_SHAPE_ID_BITS, remainder));
+		JPH_ASSERT(remainder.IsEmpty());
+
+		// normal of the cell face closest to the point
+		Vec3 local = inLocalSurfacePosition - getCellCenter(cell % SIZE, (cell / SIZE) % SIZE, cell / (SIZE * SIZE));
+		int axis = local.Abs().GetHighestComponentIndex();
+		Vec3 normal = Vec3::sZero();
+		normal.SetComponent(axis, local[axis] > 0.f ? 1.f : -1.f);
+		return normal;
+	}
+
+	void EveVoxelShape::GetSubmergedVolume(Mat44Arg inCenterOfMassTransform, Vec3Arg inScale, const Plane &inSurface, float &outTotalVolume, float &outSubmergedVolume, Vec3 &outCenterOfBuoyancy JPH_IF_DEBUG_RENDERER(, RVec3Arg inBaseOffset)) const {
+		// static terrain never floats
+		outTotalVolume = 0.f;
+		outSubmergedVolume = 0.f;
+		outCenterOfBuoyancy = Vec3::sZero();
+	}
+
+	bool EveVoxelShape::CastRay(const RayCast &inRay, const SubShapeIDCreator &inSubShapeIDCreator, RayCastResult &ioHit) const {
+		// jolt's defaults: convex shapes are solid
+		float fraction;
+		int cell;
+		if (!castRay(inRay.mOrigin, inRay.mDirection, ioHit.mFraction, true, false, fraction, cell))
+			return false;
+
+		ioHit.mFraction = fraction;
+		ioHit.mSubShapeID2 = inSubShapeIDCreator.PushID(cell, SUB_SHAPE_ID_BITS).GetID();
+		return true;
+	}
+
+	void EveVoxelShape::CastRay(const RayCast &inRay, const RayCastSettings &inRayCastSettings, const SubShapeIDCreator &inSubShapeIDCreator, CastRayCollector &ioCollector, const ShapeFilter &inShapeFilter) const {
+		if (!inShapeFilter.ShouldCollide(this, inSubShapeIDCreator.GetID()))
+			return;
+
+		// the cells are boxes, the convex settings apply to them
+	#if JPH_VERSION_MAJOR >= 5
+		bool backFaces = inRayCastSettings.mBackFaceModeConvex == EBackFaceMode::CollideWithBackFaces;
+	#else
+		bool backFaces = inRayCastSettings.mBackFaceMode == EBackFaceMode::CollideWithBackFaces;
+	#endif
+
+		// only the closest cell is reported, even to a collector taking every hit: the cells behind it are inside the terrain
+		float fraction;
+		int cell;
+		if (!castRay(inRay.mOrigin, inRay.mDirection, ioCollector.GetEarlyOutFraction(), inRayCastSettings.mTreatConvexAsSolid, backFaces, fraction, cell))
+			return;
+
+		RayCastResult hit;
+		hit.mBodyID = TransformedShape::sGetBodyID(ioCollector.GetContext());
+		hit.mFraction = fraction;
+		hit.mSubShapeID2 = inSubShapeIDCreator.PushID(cell, SUB_SHAPE_ID_BITS).GetID();
+		ioCollector.AddHit(hit);
+	}
+
+	void EveVoxelShape::CollidePoint(Vec3Arg inPoint, const SubShapeIDCreator &inSubShapeIDCreator, CollidePointCollector &ioCollector, const ShapeFilter &inShapeFilter) const {
+		if (!inShapeFilter.ShouldCollide(this, inSubShapeIDCreator.GetID()))
+			return;
+
+		int x = int(std::floor(inPoint.GetX() + SIZE / 2));
+		int y = int(std::floor(SIZE / 2 - inPoint.GetY()));
+		int z = int(std::floor(inPoint.GetZ() + SIZE / 2));
+		if (x < 0 || x >= SIZE || y < 0 || y >= SIZE || z < 0 || z >= SIZE || !isSolid(x, y, z))
+			return;
+
+		CollidePointResult result;
+		result.mBodyID = TransformedShape::sGetBodyID(ioCollector.GetContext());
+		result.mSubShapeID2 = inSubShapeIDCreator.PushID(getCellIndex(x, y, z), SUB_SHAPE_ID_BITS).GetID();
+		ioCollector.AddHit(result);
+	}
+
+	struct EveVoxelShape::TrianglesContext {
+		Mat44 localToWorld;
+		bool isInsideOut;
+		bool done;
+		CellRange range;
+		// next face to emit
+		int cell[3];
+		int side;
+	};
+
+	void EveVoxelShape::GetTrianglesStart(GetTrianglesContext &ioContext, const AABox &inBox, Vec3Arg inPositionCOM, QuatArg inRotation, Vec3Arg inScale) const {
+		static_assert(sizeof(TrianglesContext) <= sizeof(GetTrianglesContext), "The triangles context fits the jolt one");
+		TrianglesContext *context = new (&ioContext) TrianglesContext;
+
+		context->localToWorld = Mat44::sRotationTranslation(inRotation, inPositionCOM) * Mat44::sScale(inScale);
+		context->isInsideOut = ScaleHelpers::IsInsideOut(inScale);
+
+		AABox localBox = inBox.Transformed(Mat44::sInverseRotationTranslation(inRotation, inPositionCOM)).Scaled(inScale.Reciprocal());
+		context->done = !getCellRange(localBox, context->range);
+		for (int axis = 0; axis < 3; axis++)
+			context->cell[axis] = context->range.min[axis];
+		context->side = 0;
+	}
+
+	int EveVoxelShape::GetTrianglesNext(GetTrianglesContext &ioContext, int inMaxTrianglesRequested, Float3 *outTriangleVertices, const PhysicsMaterial **outMaterials) const {
+		TrianglesContext &context = reinterpret_cast<TrianglesContext &>(ioContext);
+
+		// the exposed faces of the solid cells, two triangles each (faces on the chunk border are always exposed)
+		int count = 0;
+		while (!context.done && count + 2 <= inMaxTrianglesRequested) {
+			int x = context.cell[0], y = context.cell[1], z = context.cell[2];
+			int side = context.side;
+
+			if (isSolid(x, y, z)) {
+				int nx = x + SIDE_NORMALS[side][0], ny = y - SIDE_NORMALS[side][1], nz = z + SIDE_NORMALS[side][2];
+				bool inside = nx >= 0 && nx < SIZE && ny >= 0 && ny < SIZE && nz >= 0 && nz < SIZE;
+				if (!inside || !isSolid(nx, ny, nz)) {
+					Vec3 center = getCellCenter(x, y, z) + .5f * toVec3(SIDE_NORMALS[side]);
+					Vec3 u = .5f * toVec3(SIDE_U[side]);
+					Vec3 v = .5f * toVec3(SIDE_V[side]);
+					Vec3 corners[4] = {center - u - v, center + u - v, center + u + v, center - u + v};
+
+					static constexpr int TRIANGLES[2][3] = {{0, 1, 2}, {0, 2, 3}};
+					for (const int (&triangle)[3] : TRIANGLES) {
+						(context.localToWorld * corners[triangle[0]]).StoreFloat3(outTriangleVertices++);
+						(context.localToWorld * corners[triangle[context.isInsideOut ? 2 : 1]]).StoreFloat3(outTriangleVertices++);
+						(context.localToWorld * corners[triangle[context.isInsideOut ? 1 : 2]]).StoreFloat3(outTriangleVertices++);
+					}
+					if (outMaterials) {
+						*outMaterials++ = PhysicsMaterial::sDefault;
+						*outMaterials++ = PhysicsMaterial::sDefault;
+					}
+					count += 2;
+				}
+			}
+
+			// next side, then next cell of the range (x fastest)
+			if (++context.side < 6)
+				continue;
+			context.side = 0;
+			for (int axis = 0; axis < 3; axis++) {
+				if (++context.cell[axis] <= context.range.max[axis])
+					break;
+				context.cell[axis] = context.range.min[axis];
+				if (axis == 2)
+					context.done = true;
+			}
+		}
+		return count;
+	}
+
+	float EveVoxelShape::GetVolume() const {
+		int cells = 0;
+		for (const std::atomic<uint16_t> &column : columns)
+			cells += std::popcount(column.load(std::memory_order_relaxed));
+		return float(cells);
+	}
+
+	void EveVoxelShape::sCollideConvexVsVoxels(const Shape *inShape1, const Shape *inShape2, Vec3Arg inScale1, Vec3Arg inScale2, Mat44Arg inCenterOfMassTransform1, Mat44Arg inCenterOfMassTransform2, const SubShapeIDCreator &inSubShapeIDCreator1, const SubShapeIDCreator &inSubShapeIDCreator2, const CollideShapeSettings &inCollideShapeSettings, CollideShapeCollector &ioCollector, const ShapeFilter &inShapeFilter) {
+		const EveVoxelShape *voxels = static_cast<const EveVoxelShape *>(inShape2);
+
+		// bounds of the convex shape in the voxel local space
+		Mat44 transform1To2 = inCenterOfMassTransform2.InversedRotationTranslation() * inCenterOfMassTransform1;
+		AABox bounds = inShape1->GetWorldSpaceBounds(transform1To2, inScale1);
+		bounds.ExpandBy(Vec3::sReplicate(inCollideShapeSettings.mMaxSeparationDistance));
+
+		CellRange range;
+		if (!getCellRange(bounds.Scaled(inScale2.Reciprocal()), range))
+			return;
+
+		for (int z = range.min[2]; z <= range.max[2]; z++) {
+			for (int y = range.min[1]; y <= range.max[1]; y++) {
+				for (int x = range.min[0]; x <= range.max[0]; x++) {
+					if (!voxels->isSolid(x, y, z))
+						continue;
+
+					Mat44 cellTransform = inCenterOfMassTransform2 * Mat44::sTranslation(getCellCenter(x, y, z) * inScale2);
+					CollisionDispatch::sCollideShapeVsShape(inShape1, sCellBox, inScale1, inScale2, inCenterOfMassTransform1, cellTransform, inSubShapeIDCreator1, inSubShapeIDCreator2.PushID(getCellIndex(x, y, z), SUB_SHAPE_ID_BITS), inCollideShapeSettings, ioCollector, inShapeFilter);
+					if (ioCollector.ShouldEarlyOut())
+						return;
+				}
+			}
+		}
+	}
+
+	void EveVoxelShape::sCastConvexVsVoxels(const ShapeCast &inShapeCast, const ShapeCastSettings &inShapeCastSettings, const Shape *inShape, Vec3Arg inScale, const ShapeFilter &inShapeFilter, Mat44Arg inCenterOfMassTransform2, const SubShapeIDCreator &inSubShapeIDCreator1, const SubShapeIDCreator &inSubShapeIDCreator2, CastShapeCollector &ioCollector) {
+		const EveVoxelShape *voxels = static_cast<const EveVoxelShape *>(inShape);
+
+		// the cast is in the voxel local space already, its swept bounds give the cells it can hit
+		AABox bounds = inShapeCast.mShapeWorldBounds;
+		AABox end = bounds;
+		end.Translate(inShapeCast.mDirection);
+		bounds.Encapsulate(end);
+
+		CellRange range;
+		if (!getCellRange(bounds.Scaled(inScale.Reciprocal()), range))
+			return;
+
+		for (int z = range.min[2]; z <= range.max[2]; z++) {
+			for (int y = range.min[1]; y <= range.max[1]; y++) {
+				for (int x = range.min[0]; x <= range.max[0]; x++) {
+					if (!voxels->isSolid(x, y, z))
+						continue;
+
+					// same as a compound sub shape: the cast moves into the cell space, the hits come back through the cell transform
+					Mat44 cellTransform = Mat44::sTranslation(getCellCenter(x, y, z) * inScale);
+					CollisionDispatch::sCastShapeVsShapeLocalSpace(inShapeCast.PostTransformed(cellTransform.InversedRotationTranslation()), inShapeCastSettings, sCellBox, inScale, inShapeFilter, inCenterOfMassTransform2 * cellTransform, inSubShapeIDCreator1, inSubShapeIDCreator2.PushID(getCellIndex(x, y, z), SUB_SHAPE_ID_BITS), ioCollector);
+					if (ioCollector.ShouldEarlyOut())
+						return;
+				}
+			}
+		}
+	}
+}
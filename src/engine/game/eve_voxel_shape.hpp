@@ -0,0 +1,92 @@
+#pragma once
+
+#include "eve_physx.hpp"
+
+#include <Jolt/Physics/Collision/Shape/Shape.h>
+#include <Jolt/Physics/Collision/CollideShape.h>
+#include <Jolt/Physics/Collision/ShapeCast.h>
+
+#include <array>
+#include <atomic>
+
+namespace eve {
+	/*
+	* Static collider of a whole chunk answering the queries straight from its cells: one occupancy bit per cell
+	* (512 bytes a chunk) instead of a box shape per exposed octant in a compound.
+	* Convex shapes are collided and cast against a shared unit box moved on every solid cell their bounds overlap,
+	* rays walk the grid cell by cell. The bits are set in place from any thread, an edit rebuilds neither the shape nor the body.
+	*
+	* Local space: origin at the chunk center and y up like the rest of the physics, the cells go y down like the chunk.
+	* The sub shape id of a hit is the cell index (x + y * SIZE + z * SIZE * SIZE).
+	* */
+	class EveVoxelShape final : public Shape {
+		public:
+			static constexpr int SIZE = 16;
+			static constexpr uint SUB_SHAPE_ID_BITS = 12;
+			static_assert(SIZE * SIZE * SIZE <= (1 << SUB_SHAPE_ID_BITS), "A cell index fits in the sub shape id");
+
+			EveVoxelShape();
+
+			// collide and cast handlers against every convex shape, once after RegisterTypes
+			static void sRegister();
+
+			// cell in chunk corner space (0..SIZE, y down)
+			void setSolid(int x, int y, int z, bool solid);
+			bool isSolid(int x, int y, int z) const { return (columns[x + z * SIZE].load(std::memory_order_relaxed) >> y) & 1; }
+
+			static int getCellIndex(int x, int y, int z) { return x + y * SIZE + z * SIZE * SIZE; }
+			// center of a cell in local space, unscaled
+			static Vec3 getCellCenter(int x, int y, int z) { return Vec3(x + .5f - SIZE / 2, SIZE / 2 - .5f - y, z + .5f - SIZE / 2); }
+
+			// Shape
+			virtual bool MustBeStatic() const override { return true; }
+			virtual AABox GetLocalBounds() const override { return AABox(Vec3::sReplicate(-SIZE / 2), Vec3::sReplicate(SIZE / 2)); }
+			virtual uint GetSubShapeIDBitsRecursive() const override { return SUB_SHAPE_ID_BITS; }
+			virtual float GetInnerRadius() const override { return 0.f; }
+			virtual MassProperties GetMassProperties() const override { return MassProperties(); }
+			virtual const PhysicsMaterial *GetMaterial(const SubShapeID &inSubShapeID) const override { return PhysicsMaterial::sDefault; }
+			virtual Vec3 GetSurfaceNormal(const SubShapeID &inSubShapeID, Vec3Arg inLocalSurfacePosition) const override;
+			virtual void GetSubmergedVolume(Mat44Arg inCenterOfMassTransform, Vec3Arg inScale, const Plane &inSurface, float &outTotalVolume, float &outSubmergedVolume, Vec3 &outCenterOfBuoyancy JPH_IF_DEBUG_RENDERER(, RVec3Arg inBaseOffset)) const override;
+		#ifdef JPH_DEBUG_RENDERER
+			// the terrain mesh shows the same thing
+			virtual void Draw(DebugRenderer *inRenderer, RMat44Arg inCenterOfMassTransform, Vec3Arg inScale, ColorArg inColor, bool inUseMaterialColors, bool inDrawWireframe) const override {}
+		#endif
+			virtual bool CastRay(const RayCast &inRay, const SubShapeIDCreator &inSubShapeIDCreator, RayCastResult &ioHit) const override;
+			virtual void CastRay(const RayCast &inRay, const RayCastSettings &inRayCastSettings, const SubShapeIDCreator &inSubShapeIDCreator, CastRayCollector &ioCollector, const ShapeFilter &inShapeFilter = { }) const override;
+			virtual void CollidePoint(Vec3Arg inPoint, const SubShapeIDCreator &inSubShapeIDCreator, CollidePointCollector &ioCollector, const ShapeFilter &inShapeFilter = { }) const override;
+		#if JPH_VERSION_MAJOR >= 5
+			// no soft bodies in the engine
+			virtual void CollideSoftBodyVertices(Mat44Arg inCenterOfMassTransform, Vec3Arg inScale, const CollideSoftBodyVertexIterator &inVertices, uint inNumVertices, int inCollidingShapeIndex) const override {}
+		#elif JPH_VERSION_MAJOR == 4
+			virtual void CollideSoftBodyVertices(Mat44Arg inCenterOfMassTransform, Vec3Arg inScale, SoftBodyVertex *ioVertices, uint inNumVertices, float inDeltaTime, Vec3Arg inDisplacementDueToGravity, int inCollidingShapeIndex) const override {}
+		#endif
+			virtual void GetTrianglesStart(GetTrianglesContext &ioContext, const AABox &inBox, Vec3Arg inPositionCOM, QuatArg inRotation, Vec3Arg inScale) const override;
+			virtual int GetTrianglesNext(GetTrianglesContext &ioContext, int inMaxTrianglesRequested, Float3 *outTriangleVertices, const PhysicsMaterial **outMaterials = nullptr) const override;
+			virtual Stats GetStats() const override { return Stats(sizeof(*this), 0); }
+			virtual float GetVolume() const override;
+
+		private:
+			struct CellRange {
+				int min[3];
+				int max[3];
+			};
+			struct TrianglesContext;
+
+			// cells overlapped by a local (unscaled) box, false when it misses the chunk
+			static bool getCellRange(const AABox &bounds, CellRange &outRange);
+			/*
+			* First solid cell on the local ray origin + direction * [0, maxFraction[. The cells are tested like jolt convex boxes:
+			* a ray starting in a solid cell hits at 0 when solidStart, otherwise that cell is hollow and only its back face
+			* can be hit (backFaces), the cells after it are hit on their front face.
+			* */
+			bool castRay(Vec3Arg origin, Vec3Arg direction, float maxFraction, bool solidStart, bool backFaces, float &outFraction, int &outCell) const;
+
+			static void sCollideConvexVsVoxels(const Shape *inShape1, const Shape *inShape2, Vec3Arg inScale1, Vec3Arg inScale2, Mat44Arg inCenterOfMassTransform1, Mat44Arg inCenterOfMassTransform2, const SubShapeIDCreator &inSubShapeIDCreator1, const SubShapeIDCreator &inSubShapeIDCreator2, const CollideShapeSettings &inCollideShapeSettings, CollideShapeCollector &ioCollector, const ShapeFilter &inShapeFilter);
+			static void sCastConvexVsVoxels(const ShapeCast &inShapeCast, const ShapeCastSettings &inShapeCastSettings, const Shape *inShape, Vec3Arg inScale, const ShapeFilter &inShapeFilter, Mat44Arg inCenterOfMassTransform2, const SubShapeIDCreator &inSubShapeIDCreator1, const SubShapeIDCreator &inSubShapeIDCreator2, CastShapeCollector &ioCollector);
+
+			// the unit box every solid cell is tested as
+			static RefConst<Shape> sCellBox;
+
+			std::array<std::atomic<uint16_t>, SIZE * SIZE> columns; // [x + z * SIZE], bit y
+	};
+}
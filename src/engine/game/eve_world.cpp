@@ -1,5 +1,7 @@
 #include "eve_world.hpp"
 
+#include <glm/gtx/euler_angles.hpp>
+
 namespace eve {
 
 	EveWorld::EveWorld(EveDevice &device, EveWindow &window, EveRenderer &renderer, std::unique_ptr<EveDescriptorPool> &pool)
@@ -21,28 +23,37 @@ namespace eve {
 		//physx.createPhysxSimulation(true);
 		//physx.createStack(PxTransform(PxVec3(0,0,stackZ-=10.0f)), 10, 2.0f);
 
+		physx.start();
 	}
 
 	EveWorld::~EveWorld() {
-		
+		// before the terrain releases its bodies
+		physx.stop();
 	}
 
 	void EveWorld::tick(float deltaTime) {
-		eveTerrain.tick(deltaTime);
+		// coroutines waiting on the main thread (voxel edits)
+		scheduler.pumpMainThread();
 		applyGravity(deltaTime);
+		updateDynamicBounds();
+		eveTerrain.tick(deltaTime, viewerObject.transform.translation);
 
 		keyboardController->moveInPlaneXZ(eveWindow.getGLFWwindow(), deltaTime, viewerObject);
 		camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
 		float aspect = eveRenderer.getAspectRatio();
 		camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 1000.f);
-		
-		//physx.stepPhysics();
+	}
 
-		physx.tick(deltaTime);
+	void EveWorld::updateTerrain() {
+		eveTerrain.updateChunks(viewerObject.transform.translation);
 	}
 
 	void EveWorld::spawnObject() {
+		// still loading
+		if (!eveTerrain.eveCube)
+			return;
+
 		auto newObject = EveGameObject::makeGravityObject(glm::vec3(0, 1, 0), 0.5f);
 		newObject.transform.translation = camera.getPosition();
 		newObject.transform.scale = glm::vec3(.5f, .5f, .5f);
@@ -62,36 +73,73 @@ namespace eve {
 		// Create the settings for the body itself. Note that here you can also set other properties like the restitution / friction.
 		BodyCreationSettings box_settings(box_shape, RVec3(camera.getPosition().x, -camera.getPosition().y, camera.getPosition().z), Quat::sIdentity(), EMotionType::Dynamic, Layers::MOVING);
 
-		// Create the actual rigid body
-		newObject.gravityComponent->bodyID = physx.body_interface->CreateAndAddBody(box_settings, EActivation::Activate); // Note that if we run out of bodies this can return nullptr
+		// thrown forward, the velocity goes in with the body on the next physics step
+		glm::vec3 forward = normalize(glm::vec3(camera.getInverseView()[2]));
+		forward *= 50;
+		box_settings.mLinearVelocity = Vec3(forward.x, -forward.y, forward.z);
+
+		uint32_t stateIndex;
+		newObject.gravityComponent->bodyID = physx.createTrackedBody(box_settings, stateIndex);
+		if (newObject.gravityComponent->bodyID.IsInvalid())
+			return;
+		newObject.gravityComponent->stateIndex = stateIndex;
 
 		physx.sphere_id = newObject.gravityComponent->bodyID;
 
-		// Now you can interact with the dynamic body, in this case we're going to give it a velocity.
-		// (note that if we had used CreateBody then we could have set the velocity straight on the body before adding it to the physics system)
+		// the map nodes don't move, the transform stays where it is
+		EveGameObject &spawned = gameObjects.emplace(newObject.getId(), std::move(newObject)).first->second;
+		if (bodyTransforms.size() <= stateIndex) {
+			bodyTransforms.resize(stateIndex + 1, nullptr);
+		}
+		bodyTransforms[stateIndex] = &spawned.transform;
+		std::cout << "Spawned a gravity object" << std::endl;
+	}
+
+	void EveWorld::breakVoxel() {
 		glm::vec3 forward = normalize(glm::vec3(camera.getInverseView()[2]));
-		forward *= 50;
-		physx.body_interface->SetLinearVelocity(newObject.gravityComponent->bodyID, Vec3(forward.x, -forward.y, forward.z));
-		
+		glm::ivec3 hit;
+		if (eveTerrain.raycastVoxel(camera.getPosition(), forward, 64.f, hit))
+			eveTerrain.setVoxelAt(hit, eveTerrain.voxelMap[0]);
+	}
 
-		gameObjects.emplace(newObject.getId(), std::move(newObject));
-		std::cout << "Spawned a gravity object" << std::endl;
+	void EveWorld::updateDynamicBounds() {
+		EASY_FUNCTION(profiler::colors::Magenta);
+		// only the bodies that moved get new bounds, the resting ones keep theirs
+		for (size_t i = 0; i < movedIndices.size(); i++) {
+			uint32_t index = movedIndices[i];
+			const EveBodyState &state = movedCurrent[i];
+			if (state.step == 0)
+				continue;
+
+			// where the body can get before the collider jobs catch up
+			AABox bounds = state.bounds;
+			AABox ahead = bounds;
+			ahead.Translate(state.velocity * eveTerrain.colliderLookahead);
+			bounds.Encapsulate(ahead);
+			bounds.ExpandBy(Vec3::sReplicate(eveTerrain.colliderMargin));
+			eveTerrain.setDynamicBounds(index, bounds);
+		}
 	}
 
 	void EveWorld::applyGravity(float deltaTime) {
-		for (auto &kv : gameObjects) {
-			EveGameObject &object = kv.second;
-			if (object.gravityComponent) {
-				JPH::RVec3 position = physx.body_interface->GetCenterOfMassPosition(object.gravityComponent->bodyID);
-				object.transform.translation.x = position.GetX();
-				object.transform.translation.y = -position.GetY();
-				object.transform.translation.z = position.GetZ();
-
-				JPH::Quat rotation = physx.body_interface->GetRotation(object.gravityComponent->bodyID);
-				object.transform.rotation.x = rotation.GetX();
-				object.transform.rotation.y = rotation.GetY();
-				object.transform.rotation.z = rotation.GetZ();
-			}
+		EASY_FUNCTION(profiler::colors::Magenta);
+		float alpha = physx.readMovedStates(movedIndices, movedPrevious, movedCurrent);
+
+		for (size_t i = 0; i < movedIndices.size(); i++) {
+			uint32_t index = movedIndices[i];
+			if (index >= bodyTransforms.size() || !bodyTransforms[index])
+				continue;
+
+			// nothing to interpolate from when the previous state isn't the step before (new or woken up body)
+			const EveBodyState &current = movedCurrent[i];
+			const EveBodyState &previous = movedPrevious[i].step + 1 == current.step ? movedPrevious[i] : current;
+
+			TransformComponent &transform = *bodyTransforms[index];
+			transform.translation = glm::mix(previous.position, current.position, alpha);
+
+			// back to the euler angles of the transform (Ry * Rx * Rz)
+			glm::mat4 rotation = glm::mat4_cast(glm::slerp(previous.rotation, current.rotation, alpha));
+			glm::extractEulerAngleYXZ(rotation, transform.rotation.y, transform.rotation.x, transform.rotation.z);
 		}
 	}
 
@@ -6,6 +6,7 @@
 #include "../rendering/eve_descriptors.hpp"
 #include "eve_debug.hpp"
 #include "eve_physx.hpp"
+#include "../utils/eve_scheduler.hpp"
 
 #include <memory>
 
@@ -23,10 +24,18 @@ namespace eve {
 			EveWorld &operator=(const EveWorld&) = delete;
 
 			void init();
+			// physics sync, terrain integration, input and camera, physics is stepped on its own thread (see EvePhysx::start)
 			void tick(float deltaTime);
+			// chunk map bookkeeping around the camera, on a worker while the frame is recorded (see App::run frame phases)
+			void updateTerrain();
 
+			// transforms of the moving gravity objects, interpolated between the last two physics steps
 			void applyGravity(float deltaTime);
+			// bounds of the gravity objects that moved for the terrain colliders (EveTerrain::setDynamicBounds), after applyGravity
+			void updateDynamicBounds();
 			void spawnObject();
+			// the first solid voxel in front of the camera becomes air
+			void breakVoxel();
 			void loadGameObjects();
 
 		private:
@@ -38,11 +47,19 @@ namespace eve {
 			EveGameObject viewerObject;
 			EveKeyboardController *keyboardController;
 
+			// [physics state index], transform driven by the body
+			std::vector<TransformComponent*> bodyTransforms;
+			// bodies that moved during the last steps, interpolated every frame until the next one
+			std::vector<uint32_t> movedIndices;
+			std::vector<EveBodyState> movedPrevious;
+			std::vector<EveBodyState> movedCurrent;
+
 		public: 
 			EveGameObject::Map gameObjects;
 			EveCamera camera{};
-			EvePhysx physx{};
-			EveTerrain eveTerrain{eveDevice, physx};
+			EveScheduler scheduler{};
+			EvePhysx physx{scheduler};
+			EveTerrain eveTerrain{eveDevice, physx, scheduler};
 			EveDebug debugMenu{eveWindow, eveRenderer, eveDevice, globalPool, eveTerrain};
 	};
 }
\ No newline at end of file
@@ -220,4 +220,14 @@ namespace eve {
 		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 	}
 
+	void EvePipeline::enableTranslucentBlending(PipelineConfigInfo& configInfo, float opacity) {
+		enableAlphaBlending(configInfo);
+		configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_CONSTANT_ALPHA;
+		configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA;
+		configInfo.colorBlendInfo.blendConstants[3] = opacity;
+
+		// the faces behind a translucent one are still drawn
+		configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+	}
+
 }
\ No newline at end of file
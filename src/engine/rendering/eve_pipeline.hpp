@@ -48,6 +48,8 @@ namespace eve {
 
 			static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 			static void enableAlphaBlending(PipelineConfigInfo& configInfo);
+			// blended with a constant opacity and depth tested without writing, for faces drawn back to front after the opaque ones
+			static void enableTranslucentBlending(PipelineConfigInfo& configInfo, float opacity);
 
 		private:
 			static std::vector<char> readFile(const std::string& filepath);
@@ -37,6 +37,8 @@ namespace eve
 		if (requestedRenderMode != currentRenderMode) {
 			vkDeviceWaitIdle(eveDevice.device());
 			evePipeline.swap(inactivePipeline);
+			chunkPipeline.swap(inactiveChunkPipeline);
+			translucentChunkPipeline.swap(inactiveTranslucentChunkPipeline);
 			currentRenderMode = requestedRenderMode;
 		}
 	}
@@ -83,6 +85,38 @@ namespace eve
 			"shaders/base_shader.vert.spv",
 			"shaders/base_shader.frag.spv",
 			pipelineConfig);
+
+		// the chunk vertex shader unpacks into the same outputs, the fragment shader is shared
+		pipelineConfig.bindingDescriptions = EveModel::ChunkVertex::getBindingDescriptions();
+		pipelineConfig.attributeDescriptions = EveModel::ChunkVertex::getAttributeDescriptions();
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		chunkPipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
+
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_LINE;
+		inactiveChunkPipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
+
+		EvePipeline::enableTranslucentBlending(pipelineConfig, TRANSLUCENT_OPACITY);
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		translucentChunkPipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
+
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_LINE;
+		inactiveTranslucentChunkPipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
 	}
 
 	void BaseRenderSystem::update(FrameInfo &frameInfo, GlobalUbo &ubo){
@@ -148,16 +182,28 @@ namespace eve
 		std::cout << std::endl << std::endl;
 
 		EASY_BLOCK("chunkObjects");
+		// octant meshing still uses plain cube models, switch only when the vertex format changes
+		EvePipeline *boundPipeline = evePipeline.get();
+		glm::vec3 eye = frameInfo.camera.getPosition();
 		for (auto &kv : frameInfo.terrain.chunkMap) {
 			Chunk *chunk = kv.second;
-			if (!chunk->isQueued) {
+			if (!chunk->isQueued && !frameInfo.terrain.isAboveCut(*chunk)) {
 				boost::lock_guard<boost::mutex> lock(chunk->mutex);
+				// back facing sides are never drawn (meshes grouped by side only)
+				uint8_t visibleSides = chunk->getVisibleSides(eye);
 
 				for (auto& kv : chunk->chunkObjectMap) {
 					EASY_BLOCK("single cube");
 					auto& obj = kv.second;
 
-					if (obj.model) {
+					// face records are drawn by ChunkFaceRenderSystem
+					if (obj.model && !obj.model->hasFaceRecords()) {
+						EvePipeline *pipeline = obj.model->hasChunkVertices() ? chunkPipeline.get() : evePipeline.get();
+						if (pipeline != boundPipeline) {
+							pipeline->bind(frameInfo.commandBuffer);
+							boundPipeline = pipeline;
+						}
+
 						SimplePushConstantData push{};
 						push.modelMatrix = obj.transform.mat4();
 
@@ -183,12 +229,83 @@ namespace eve
 							&push);
 
 						obj.model->bind(frameInfo.commandBuffer);
-						obj.model->draw(frameInfo.commandBuffer);
+						obj.model->draw(frameInfo.commandBuffer, visibleSides);
 					}
 					EASY_END_BLOCK;
 				}
+
+				// cap of the cut view, the layer the cut goes through
+				int cutLayer = frameInfo.terrain.getCutLayer(*chunk);
+				if (cutLayer >= 0 && chunk->capModel && chunk->capModel->hasChunkVertices()) {
+					if (chunkPipeline.get() != boundPipeline) {
+						chunkPipeline->bind(frameInfo.commandBuffer);
+						boundPipeline = chunkPipeline.get();
+					}
+
+					TransformComponent transform{};
+					transform.translation = glm::vec3(chunk->position) - glm::vec3(CHUNK_SIZE / 2);
+					SimplePushConstantData push{};
+					push.modelMatrix = transform.mat4();
+					push.normalMatrix = transform.normalMatrix();
+					vkCmdPushConstants(
+						frameInfo.commandBuffer,
+						pipelineLayout,
+						VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+						0,
+						sizeof(SimplePushConstantData),
+						&push);
+
+					chunk->capModel->bind(frameInfo.commandBuffer);
+					chunk->capModel->drawLayer(frameInfo.commandBuffer, cutLayer);
+				}
 			}
 		}
 		EASY_END_BLOCK;
 	}
+	void BaseRenderSystem::renderTranslucent(FrameInfo &frameInfo)
+	{
+		EASY_FUNCTION(profiler::colors::Blue);
+		EASY_BLOCK("renderTranslucent");
+
+		// back to front, the terrain sorted the chunks and the faces inside them
+		bool bound = false;
+		for (Chunk *chunk : frameInfo.terrain.translucentChunks) {
+			if (chunk->isQueued || frameInfo.terrain.isAboveCut(*chunk))
+				continue;
+
+			boost::lock_guard<boost::mutex> lock(chunk->mutex);
+			std::shared_ptr<EveModel> &model = chunk->translucentModel;
+			// face records are drawn by ChunkFaceRenderSystem
+			if (!model || !model->hasChunkVertices())
+				continue;
+
+			if (!bound) {
+				translucentChunkPipeline->bind(frameInfo.commandBuffer);
+				vkCmdBindDescriptorSets(
+					frameInfo.commandBuffer,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					pipelineLayout,
+					0, 1,
+					&frameInfo.globalDescriptorSet,
+					0, nullptr);
+				bound = true;
+			}
+
+			TransformComponent transform{};
+			transform.translation = glm::vec3(chunk->position) - glm::vec3(CHUNK_SIZE / 2);
+			SimplePushConstantData push{};
+			push.modelMatrix = transform.mat4();
+			push.normalMatrix = transform.normalMatrix();
+			vkCmdPushConstants(
+				frameInfo.commandBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0,
+				sizeof(SimplePushConstantData),
+				&push);
+
+			model->bind(frameInfo.commandBuffer);
+			model->draw(frameInfo.commandBuffer);
+		}
+	}
 }
\ No newline at end of file
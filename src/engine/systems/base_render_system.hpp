@@ -31,6 +31,8 @@ namespace eve {
 
 			void update(FrameInfo &frameInfo, GlobalUbo &ubo);
 			void renderGameObjects(FrameInfo &frameInfo);
+			// translucent chunk meshes (chunk vertices), after every opaque draw
+			void renderTranslucent(FrameInfo &frameInfo);
 
 		private:
 			void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
@@ -43,6 +45,12 @@ namespace eve {
 			EveTerrain &eveTerrain;
 			std::unique_ptr<EvePipeline> evePipeline;
 			std::unique_ptr<EvePipeline> inactivePipeline;
+			// same layout, packed chunk vertices (EveModel::ChunkVertex)
+			std::unique_ptr<EvePipeline> chunkPipeline;
+			std::unique_ptr<EvePipeline> inactiveChunkPipeline;
+			// same with blending, no depth writes
+			std::unique_ptr<EvePipeline> translucentChunkPipeline;
+			std::unique_ptr<EvePipeline> inactiveTranslucentChunkPipeline;
 			VkPipelineLayout pipelineLayout;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "chunk_face_render_system.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <stdexcept>
+#include <iostream>
+
+namespace eve
+{
+	struct ChunkFacePushConstantData
+	{
+		glm::mat4 modelMatrix{1.f};
+		glm::mat4 normalMatrix{1.f};
+	};
+
+	ChunkFaceRenderSystem::ChunkFaceRenderSystem(EveDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : eveDevice{device}
+	{
+		faceSetLayout = EveDescriptorSetLayout::Builder(eveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // face records
+			.build({0});
+
+		facePools.push_back(createFacePool());
+
+		createPipelineLayout(globalSetLayout);
+		createPipeline(renderPass);
+	}
+
+	ChunkFaceRenderSystem::~ChunkFaceRenderSystem()
+	{
+		vkDestroyPipelineLayout(eveDevice.device(), pipelineLayout, nullptr);
+	}
+
+	std::unique_ptr<EveDescriptorPool> ChunkFaceRenderSystem::createFacePool() const
+	{
+		return EveDescriptorPool::Builder(eveDevice)
+			.setMaxSets(FACE_SETS_PER_POOL)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, FACE_SETS_PER_POOL)
+			.setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+			.build();
+	}
+
+	void ChunkFaceRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ChunkFacePushConstantData);
+
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout, faceSetLayout->getDescriptorSetLayout()};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(eveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout");
+		}
+	}
+
+	void ChunkFaceRenderSystem::createPipeline(VkRenderPass renderPass)
+	{
+		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+		// no vertex input, everything comes from the face storage buffer
+		PipelineConfigInfo pipelineConfig{};
+		EvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+		pipelineConfig.attributeDescriptions.clear();
+		pipelineConfig.bindingDescriptions.clear();
+		pipelineConfig.renderPass = renderPass;
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		evePipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_face_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
+
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_LINE;
+		inactivePipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_face_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
+
+		EvePipeline::enableTranslucentBlending(pipelineConfig, TRANSLUCENT_OPACITY);
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		translucentPipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_face_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
+
+		pipelineConfig.rasterizationInfo.polygonMode = VK_POLYGON_MODE_LINE;
+		inactiveTranslucentPipeline = std::make_unique<EvePipeline>(
+			eveDevice,
+			"shaders/chunk_face_shader.vert.spv",
+			"shaders/base_shader.frag.spv",
+			pipelineConfig);
+	}
+
+	void ChunkFaceRenderSystem::switchRenderMode() {
+		if (requestedRenderMode != currentRenderMode) {
+			vkDeviceWaitIdle(eveDevice.device());
+			evePipeline.swap(inactivePipeline);
+			translucentPipeline.swap(inactiveTranslucentPipeline);
+			currentRenderMode = requestedRenderMode;
+		}
+	}
+
+	VkDescriptorSet ChunkFaceRenderSystem::getFaceSet(const std::shared_ptr<EveModel> &model)
+	{
+		auto it = faceSets.find(model.get());
+		if (it != faceSets.end()) {
+			if (!it->second.model.expired())
+				return it->second.descriptorSet;
+
+			// a new model got the address of a destroyed one
+			retiredSets.push_back({it->second.descriptorSet, it->second.pool, frameCount});
+			faceSets.erase(it);
+		}
+
+		VkDescriptorSet descriptorSet;
+		auto bufferInfo = model->getFaceBufferInfo();
+		auto allocate = [&](size_t pool) {
+			return EveDescriptorWriter(*faceSetLayout, *facePools[pool])
+				.writeBuffer(0, &bufferInfo)
+				.build(descriptorSet);
+		};
+
+		// the newest pool first, the older ones get the sets freed by retireFaceSets
+		size_t pool = facePools.size();
+		bool allocated = false;
+		while (!allocated && pool > 0)
+			allocated = allocate(--pool);
+		if (!allocated) {
+			facePools.push_back(createFacePool());
+			pool = facePools.size() - 1;
+			allocated = allocate(pool);
+		}
+		if (!allocated) {
+			if (!allocationFailed)
+				std::cout << "failed to allocate a face descriptor set (" << facePools.size() << " pools of " << FACE_SETS_PER_POOL << " models)" << std::endl;
+			allocationFailed = true;
+			return VK_NULL_HANDLE;
+		}
+
+		faceSets.emplace(model.get(), FaceSet{model, descriptorSet, pool});
+		return descriptorSet;
+	}
+
+	void ChunkFaceRenderSystem::retireFaceSets()
+	{
+		for (auto it = faceSets.begin(); it != faceSets.end();) {
+			if (it->second.model.expired()) {
+				retiredSets.push_back({it->second.descriptorSet, it->second.pool, frameCount});
+				it = faceSets.erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+
+		// [pool], freed with the pool they come from
+		std::vector<std::vector<VkDescriptorSet>> toFree(facePools.size());
+		for (auto it = retiredSets.begin(); it != retiredSets.end();) {
+			if (it->frame + EveSwapChain::MAX_FRAMES_IN_FLIGHT <= frameCount) {
+				toFree[it->pool].push_back(it->descriptorSet);
+				it = retiredSets.erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+		for (size_t pool = 0; pool < toFree.size(); pool++) {
+			if (!toFree[pool].empty())
+				facePools[pool]->freeDescriptors(toFree[pool]);
+		}
+	}
+
+	void ChunkFaceRenderSystem::render(FrameInfo &frameInfo)
+	{
+		EASY_FUNCTION(profiler::colors::Blue);
+		EASY_BLOCK("renderChunkFaces");
+
+		frameCount++;
+		retireFaceSets();
+
+		requestedRenderMode = frameInfo.debugMenu.requestedRenderMode;
+		switchRenderMode();
+
+		evePipeline->bind(frameInfo.commandBuffer);
+
+		vkCmdBindDescriptorSets(
+			frameInfo.commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			0, 1,
+			&frameInfo.globalDescriptorSet,
+			0, nullptr);
+
+		glm::vec3 eye = frameInfo.camera.getPosition();
+		for (auto &kv : frameInfo.terrain.chunkMap) {
+			Chunk *chunk = kv.second;
+			if (chunk->isQueued || frameInfo.terrain.isAboveCut(*chunk))
+				continue;
+
+			// back facing sides are never drawn
+			uint8_t visibleSides = chunk->getVisibleSides(eye);
+
+			boost::lock_guard<boost::mutex> lock(chunk->mutex);
+			for (auto &kv : chunk->chunkObjectMap) {
+				auto &obj = kv.second;
+				if (!obj.model || !obj.model->hasFaceRecords())
+					continue;
+
+				VkDescriptorSet faceSet = getFaceSet(obj.model);
+				if (faceSet == VK_NULL_HANDLE)
+					continue;
+
+				vkCmdBindDescriptorSets(
+					frameInfo.commandBuffer,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					pipelineLayout,
+					1, 1,
+					&faceSet,
+					0, nullptr);
+
+				ChunkFacePushConstantData push{};
+				push.modelMatrix = obj.transform.mat4();
+				push.normalMatrix = obj.transform.normalMatrix();
+				vkCmdPushConstants(
+					frameInfo.commandBuffer,
+					pipelineLayout,
+					VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+					0,
+					sizeof(ChunkFacePushConstantData),
+					&push);
+
+				obj.model->draw(frameInfo.commandBuffer, visibleSides);
+			}
+
+			// cap of the cut view, the layer the cut goes through
+			int cutLayer = frameInfo.terrain.getCutLayer(*chunk);
+			if (cutLayer < 0 || !chunk->capModel || !chunk->capModel->hasFaceRecords())
+				continue;
+
+			VkDescriptorSet capSet = getFaceSet(chunk->capModel);
+			if (capSet == VK_NULL_HANDLE)
+				continue;
+
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				1, 1,
+				&capSet,
+				0, nullptr);
+
+			TransformComponent transform{};
+			transform.translation = glm::vec3(chunk->position) - glm::vec3(CHUNK_SIZE / 2);
+			ChunkFacePushConstantData push{};
+			push.modelMatrix = transform.mat4();
+			push.normalMatrix = transform.normalMatrix();
+			vkCmdPushConstants(
+				frameInfo.commandBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0,
+				sizeof(ChunkFacePushConstantData),
+				&push);
+
+			chunk->capModel->drawLayer(frameInfo.commandBuffer, cutLayer);
+		}
+	}
+	void ChunkFaceRenderSystem::renderTranslucent(FrameInfo &frameInfo)
+	{
+		EASY_FUNCTION(profiler::colors::Blue);
+		EASY_BLOCK("renderTranslucentChunkFaces");
+
+		// back to front, the terrain sorted the chunks and the faces inside them
+		bool bound = false;
+		for (Chunk *chunk : frameInfo.terrain.translucentChunks) {
+			if (chunk->isQueued || frameInfo.terrain.isAboveCut(*chunk))
+				continue;
+
+			boost::lock_guard<boost::mutex> lock(chunk->mutex);
+			if (!chunk->translucentModel || !chunk->translucentModel->hasFaceRecords())
+				continue;
+
+			VkDescriptorSet faceSet = getFaceSet(chunk->translucentModel);
+			if (faceSet == VK_NULL_HANDLE)
+				continue;
+
+			if (!bound) {
+				translucentPipeline->bind(frameInfo.commandBuffer);
+				vkCmdBindDescriptorSets(
+					frameInfo.commandBuffer,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					pipelineLayout,
+					0, 1,
+					&frameInfo.globalDescriptorSet,
+					0, nullptr);
+				bound = true;
+			}
+
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				1, 1,
+				&faceSet,
+				0, nullptr);
+
+			TransformComponent transform{};
+			transform.translation = glm::vec3(chunk->position) - glm::vec3(CHUNK_SIZE / 2);
+			ChunkFacePushConstantData push{};
+			push.modelMatrix = transform.mat4();
+			push.normalMatrix = transform.normalMatrix();
+			vkCmdPushConstants(
+				frameInfo.commandBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0,
+				sizeof(ChunkFacePushConstantData),
+				&push);
+
+			chunk->translucentModel->draw(frameInfo.commandBuffer);
+		}
+	}
+}
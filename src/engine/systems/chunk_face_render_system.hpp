@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../eve_window.hpp"
+
+#include "../device/eve_device.hpp"
+
+#include "../rendering/eve_pipeline.hpp"
+#include "../rendering/eve_renderer.hpp"
+#include "../rendering/eve_descriptors.hpp"
+
+#include "../data/eve_frame_info.hpp"
+
+#include "../game/eve_game_object.hpp"
+
+// std
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <easy/profiler.h>
+
+namespace eve {
+	/*
+	* Draws the chunks meshed into face records (CHUNK_RENDER_FACES).
+	* Every chunk model (sections, cap, translucent) gets a descriptor set (set 1) pointing at its face storage buffer,
+	* the vertex shader expands each record into a quad from gl_VertexIndex.
+	* The sets come from pools of FACE_SETS_PER_POOL, a new pool is added when all of them are full.
+	*/
+	class ChunkFaceRenderSystem {
+		public:
+			static constexpr uint32_t FACE_SETS_PER_POOL = 4096;
+
+			ChunkFaceRenderSystem(EveDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+			~ChunkFaceRenderSystem();
+
+			ChunkFaceRenderSystem(const ChunkFaceRenderSystem&) = delete;
+			ChunkFaceRenderSystem &operator=(const ChunkFaceRenderSystem&) = delete;
+
+			void render(FrameInfo &frameInfo);
+			// translucent chunk meshes (face records), after every opaque draw
+			void renderTranslucent(FrameInfo &frameInfo);
+
+		private:
+			struct FaceSet {
+				std::weak_ptr<EveModel> model;
+				VkDescriptorSet descriptorSet;
+				size_t pool; // index in facePools
+			};
+			struct RetiredSet {
+				VkDescriptorSet descriptorSet;
+				size_t pool;
+				uint64_t frame; // frame it got retired
+			};
+
+			void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+			void createPipeline(VkRenderPass renderPass);
+			void switchRenderMode();
+
+			VkDescriptorSet getFaceSet(const std::shared_ptr<EveModel> &model);
+			// sets of destroyed models are freed once no frame in flight can use them anymore
+			void retireFaceSets();
+
+			VkPolygonMode currentRenderMode = VK_POLYGON_MODE_FILL;
+			VkPolygonMode requestedRenderMode = VK_POLYGON_MODE_FILL;
+
+			EveDevice &eveDevice;
+			std::unique_ptr<EvePipeline> evePipeline;
+			std::unique_ptr<EvePipeline> inactivePipeline;
+			// same with blending, no depth writes
+			std::unique_ptr<EvePipeline> translucentPipeline;
+			std::unique_ptr<EvePipeline> inactiveTranslucentPipeline;
+			VkPipelineLayout pipelineLayout;
+
+			std::unique_ptr<EveDescriptorSetLayout> faceSetLayout;
+			std::unique_ptr<EveDescriptorPool> createFacePool() const;
+			std::vector<std::unique_ptr<EveDescriptorPool>> facePools;
+			std::unordered_map<const EveModel*, FaceSet> faceSets;
+			std::vector<RetiredSet> retiredSets;
+			bool allocationFailed = false; // reported once, the models without a set aren't drawn
+			uint64_t frameCount = 0;
+	};
+}
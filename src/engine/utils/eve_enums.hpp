@@ -3,6 +3,29 @@
 namespace eve {
 	enum EveTerrainMeshingMode {
 		MESHING_OCTANT,
-		MESHING_CHUNK
+		MESHING_CHUNK,
+		MESHING_GREEDY
+	};
+
+	// what the chunk meshers output: packed vertices + indices, or one record per face pulled by the vertex shader
+	enum EveChunkRenderMode {
+		CHUNK_RENDER_VERTICES,
+		CHUNK_RENDER_FACES
+	};
+
+	// terrain colliders: a compound per section of a box per exposed octant or of the solid cells merged in large boxes,
+	// or one voxel shape per chunk reading the cells
+	enum EveChunkColliderMode {
+		COLLIDER_BOXES,
+		COLLIDER_MERGED_BOXES,
+		COLLIDER_VOXEL_SHAPE
+	};
+
+	// ordered, a chunk only moves forward except when a remesh sends it back to NOISED
+	enum ChunkStage {
+		CHUNK_STAGE_CREATED,
+		CHUNK_STAGE_NOISED,
+		CHUNK_STAGE_MESHED,
+		CHUNK_STAGE_UPLOADED
 	};
 }
\ No newline at end of file
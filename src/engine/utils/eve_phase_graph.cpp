@@ -0,0 +1,97 @@
+#include "eve_phase_graph.hpp"
+
+#include <easy/profiler.h>
+
+#include <cassert>
+#include <chrono>
+
+namespace eve {
+
+	EvePhaseGraph::PhaseId EvePhaseGraph::addPhase(std::string name, std::function<void()> function, EveSchedulerLane lane, std::vector<PhaseId> dependencies) {
+		PhaseId id = phases.size();
+
+		Phase phase{};
+		phase.name = std::move(name);
+		phase.function = std::move(function);
+		phase.lane = lane;
+		phase.dependencyCount = static_cast<unsigned int>(dependencies.size());
+		phases.push_back(std::move(phase));
+
+		// dependencies are always older phases, the graph can't have cycles
+		for (PhaseId dependency : dependencies) {
+			assert(dependency < id && "Phase dependencies must be declared before the phase");
+			phases[dependency].dependents.push_back(id);
+		}
+		return id;
+	}
+
+	void EvePhaseGraph::run() {
+		EASY_FUNCTION(profiler::colors::Orange);
+
+		std::vector<PhaseId> roots;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			finished_ = 0;
+			readyMain_.clear();
+			for (PhaseId id = 0; id < phases.size(); id++) {
+				phases[id].remaining = phases[id].dependencyCount;
+				if (phases[id].dependencyCount == 0)
+					roots.push_back(id);
+			}
+		}
+
+		for (PhaseId id : roots)
+			dispatch(id);
+
+		// the main thread runs its own phases as they get ready, and sleeps while only workers have something to do
+		for (;;) {
+			PhaseId id;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				phaseDone_.wait(lock, [this] { return !readyMain_.empty() || finished_ == phases.size(); });
+				if (readyMain_.empty())
+					return;
+
+				id = readyMain_.front();
+				readyMain_.erase(readyMain_.begin());
+			}
+			runPhase(id);
+		}
+	}
+
+	void EvePhaseGraph::dispatch(PhaseId id) {
+		if (phases[id].lane == LANE_MAIN) {
+			{
+				boost::lock_guard<boost::mutex> lock(mutex_);
+				readyMain_.push_back(id);
+			}
+			phaseDone_.notify_all();
+		}
+		else {
+			eveScheduler.post([this, id] { runPhase(id); }, phases[id].lane);
+		}
+	}
+
+	void EvePhaseGraph::runPhase(PhaseId id) {
+		EASY_BLOCK("Frame Phase");
+		Phase &phase = phases[id];
+
+		auto start = std::chrono::high_resolution_clock::now();
+		phase.function();
+		phase.lastTimeMs = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::vector<PhaseId> ready;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			for (PhaseId dependent : phase.dependents) {
+				if (--phases[dependent].remaining == 0)
+					ready.push_back(dependent);
+			}
+			finished_++;
+		}
+
+		for (PhaseId dependent : ready)
+			dispatch(dependent);
+		phaseDone_.notify_all();
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "eve_scheduler.hpp"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace eve {
+	/*
+	* Per-frame dependency graph of engine phases.
+	* Phases are declared once (dependencies must be declared before the phases using them)
+	* and run() executes the whole graph every frame:
+	*	- LANE_MAIN phases run on the calling thread (vulkan, glfw, imgui)
+	*	- other phases are posted to the scheduler lane and overlap with the main thread
+	* run() returns once every phase is done, that's the end of frame sync point.
+	*/
+	class EvePhaseGraph {
+		public:
+			using PhaseId = size_t;
+
+			EvePhaseGraph(EveScheduler &scheduler) : eveScheduler{scheduler} {}
+
+			EvePhaseGraph(const EvePhaseGraph&) = delete;
+			EvePhaseGraph &operator=(const EvePhaseGraph&) = delete;
+
+			PhaseId addPhase(std::string name, std::function<void()> function, EveSchedulerLane lane = LANE_MAIN, std::vector<PhaseId> dependencies = {});
+			void run();
+
+			size_t getPhaseCount() const { return phases.size(); }
+			const std::string &getPhaseName(PhaseId id) const { return phases[id].name; }
+			// duration of the phase during the last run(), for the debug menu
+			float getPhaseTimeMs(PhaseId id) const { return phases[id].lastTimeMs; }
+
+		private:
+			struct Phase {
+				std::string name;
+				std::function<void()> function;
+				EveSchedulerLane lane;
+				std::vector<PhaseId> dependents;
+				unsigned int dependencyCount = 0;
+				unsigned int remaining = 0;
+				float lastTimeMs = 0.f;
+			};
+
+			void dispatch(PhaseId id);
+			void runPhase(PhaseId id);
+
+			EveScheduler &eveScheduler;
+			std::vector<Phase> phases;
+
+			boost::mutex mutex_;
+			boost::condition_variable phaseDone_;
+			std::vector<PhaseId> readyMain_;
+			size_t finished_ = 0;
+	};
+}
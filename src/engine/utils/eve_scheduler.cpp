@@ -0,0 +1,263 @@
+#include "eve_scheduler.hpp"
+
+#include <Jolt/Core/Memory.h>
+#include <Jolt/Physics/PhysicsSettings.h>
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace eve {
+
+	EveScheduler::EveScheduler(unsigned int workers, unsigned int physicsReserved) {
+		// barriers are allocated through jolt's allocator, it has to be registered before Init
+		JPH::RegisterDefaultAllocator();
+		JobSystemWithBarrier::Init(JPH::cMaxPhysicsBarriers);
+
+		// the main thread is the last core, it participates in physics through WaitForJobs
+		if (workers == 0)
+			workers = std::max(2u, boost::thread::hardware_concurrency()) - 1;
+		workerCount = workers;
+
+		if (physicsReserved == 0)
+			physicsReserved = std::max(1u, workerCount / 4);
+		setPhysicsReservedWorkers(physicsReserved);
+
+		std::cout << "created scheduler with " << workerCount << " workers (" << physicsReservedWorkers << " reserved for physics)" << std::endl;
+		for (unsigned int i = 0; i < workerCount; i++)
+			workers_.create_thread([this] { workerLoop(); });
+	}
+
+	EveScheduler::~EveScheduler() {
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		workAvailable_.notify_all();
+		workers_.join_all();
+
+		for (std::deque<Task> *queue : {&physicsQueue_, &frameQueue_, &backgroundQueue_, &mainQueue_}) {
+			for (Task &task : *queue) {
+				// jolt jobs still holding a queue reference must be released, barriers wait on them
+				if (task.job)
+					task.job->Release();
+				// nothing will resume these coroutines anymore, free their frames
+				if (task.resume)
+					task.resume.destroy();
+			}
+			queue->clear();
+		}
+		for (Poll &poll : polls_)
+			poll.handle.destroy();
+		polls_.clear();
+	}
+
+	void EveScheduler::setPhysicsReservedWorkers(unsigned int count) {
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		// background work always keeps at least one worker
+		physicsReservedWorkers = std::min(count, workerCount > 1 ? workerCount - 1 : 0);
+	}
+
+	void EveScheduler::post(std::function<void()> task, EveSchedulerLane lane) {
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			if (lane == LANE_PHYSICS)
+				physicsQueue_.push_back({nullptr, std::move(task)});
+			else if (lane == LANE_FRAME)
+				frameQueue_.push_back({nullptr, std::move(task)});
+			else if (lane == LANE_BACKGROUND)
+				backgroundQueue_.push_back({nullptr, std::move(task)});
+			else {
+				mainQueue_.push_back({nullptr, std::move(task)});
+				return;
+			}
+		}
+		workAvailable_.notify_one();
+	}
+
+	void EveScheduler::postResume(std::coroutine_handle<> handle, EveSchedulerLane lane) {
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			Task task{nullptr, nullptr, handle};
+			if (lane == LANE_PHYSICS)
+				physicsQueue_.push_back(std::move(task));
+			else if (lane == LANE_FRAME)
+				frameQueue_.push_back(std::move(task));
+			else if (lane == LANE_BACKGROUND)
+				backgroundQueue_.push_back(std::move(task));
+			else {
+				mainQueue_.push_back(std::move(task));
+				return;
+			}
+		}
+		workAvailable_.notify_one();
+	}
+
+	void EveScheduler::pollResume(std::function<bool()> ready, std::coroutine_handle<> handle, EveSchedulerLane lane) {
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		polls_.push_back({std::move(ready), handle, lane});
+	}
+
+	void EveScheduler::pumpMainThread() {
+		std::vector<Poll> polls;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			polls.swap(polls_);
+		}
+
+		// the ready ones are resumed, the main lane ones still this frame
+		std::vector<Poll> pending;
+		for (Poll &poll : polls) {
+			if (poll.ready())
+				postResume(poll.handle, poll.lane);
+			else
+				pending.push_back(std::move(poll));
+		}
+
+		std::deque<Task> tasks;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			for (Poll &poll : pending)
+				polls_.push_back(std::move(poll));
+			tasks.swap(mainQueue_);
+		}
+
+		// tasks posted while running these go to the next frame
+		for (Task &task : tasks)
+			task.run();
+	}
+
+	void EveScheduler::cancel(EveSchedulerLane lane) {
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		// jolt jobs are owned by a barrier and a dropped resume would leak its coroutine frame, only plain tasks go
+		std::deque<Task> &queue = lane == LANE_PHYSICS ? physicsQueue_ : lane == LANE_FRAME ? frameQueue_ : lane == LANE_BACKGROUND ? backgroundQueue_ : mainQueue_;
+		queue.erase(
+			std::remove_if(queue.begin(), queue.end(), [](const Task &task) { return task.isCancellable(); }),
+			queue.end());
+		laneIdle_.notify_all();
+	}
+
+	void EveScheduler::waitIdle(EveSchedulerLane lane) {
+		assert(lane != LANE_MAIN && "The main lane is drained by pumpMainThread, not by the workers");
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		if (lane == LANE_PHYSICS)
+			laneIdle_.wait(lock, [this] { return physicsQueue_.empty() && runningPhysics == 0; });
+		else if (lane == LANE_FRAME)
+			laneIdle_.wait(lock, [this] { return frameQueue_.empty() && runningFrame == 0; });
+		else
+			laneIdle_.wait(lock, [this] { return backgroundQueue_.empty() && runningBackground == 0; });
+	}
+
+	size_t EveScheduler::getQueuedCount(EveSchedulerLane lane) {
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		if (lane == LANE_PHYSICS)
+			return physicsQueue_.size();
+		if (lane == LANE_FRAME)
+			return frameQueue_.size();
+		if (lane == LANE_BACKGROUND)
+			return backgroundQueue_.size();
+		return mainQueue_.size();
+	}
+
+	bool EveScheduler::canRunBackground() const {
+		return !backgroundQueue_.empty() && runningBackground < workerCount - physicsReservedWorkers;
+	}
+
+	void EveScheduler::workerLoop() {
+		for (;;) {
+			Task task;
+			EveSchedulerLane lane;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				workAvailable_.wait(lock, [this] { return stopping_ || !physicsQueue_.empty() || !frameQueue_.empty() || canRunBackground(); });
+
+				if (stopping_)
+					return;
+
+				if (!physicsQueue_.empty()) {
+					task = std::move(physicsQueue_.front());
+					physicsQueue_.pop_front();
+					lane = LANE_PHYSICS;
+					runningPhysics++;
+				}
+				// the main thread is waiting on the frame phases, they don't count against the background cap
+				else if (!frameQueue_.empty()) {
+					task = std::move(frameQueue_.front());
+					frameQueue_.pop_front();
+					lane = LANE_FRAME;
+					runningFrame++;
+				}
+				else {
+					task = std::move(backgroundQueue_.front());
+					backgroundQueue_.pop_front();
+					lane = LANE_BACKGROUND;
+					runningBackground++;
+				}
+			}
+
+			task.run();
+
+			{
+				boost::lock_guard<boost::mutex> lock(mutex_);
+				if (lane == LANE_PHYSICS)
+					runningPhysics--;
+				else if (lane == LANE_FRAME)
+					runningFrame--;
+				else
+					runningBackground--;
+			}
+			// a background slot got freed, or a lane may have become idle
+			workAvailable_.notify_one();
+			laneIdle_.notify_all();
+		}
+	}
+
+	void EveScheduler::Task::run() {
+		if (job) {
+			job->Execute();
+			job->Release();
+		}
+		else if (resume) {
+			resume.resume();
+		}
+		else {
+			function();
+		}
+	}
+
+	EveScheduler::JobHandle EveScheduler::CreateJob(const char *inName, JPH::ColorArg inColor, const JobFunction &inJobFunction, JPH::uint32 inNumDependencies) {
+		Job *job = new Job(inName, inColor, this, inJobFunction, inNumDependencies);
+		JobHandle handle(job);
+
+		// jobs with dependencies are queued by jolt once the last dependency is done
+		if (inNumDependencies == 0)
+			QueueJob(job);
+
+		return handle;
+	}
+
+	void EveScheduler::QueueJob(Job *inJob) {
+		// the queue keeps its own reference until the job is executed
+		inJob->AddRef();
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			physicsQueue_.push_back({inJob, nullptr});
+		}
+		workAvailable_.notify_one();
+	}
+
+	void EveScheduler::QueueJobs(Job **inJobs, JPH::uint inNumJobs) {
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			for (JPH::uint i = 0; i < inNumJobs; i++) {
+				inJobs[i]->AddRef();
+				physicsQueue_.push_back({inJobs[i], nullptr});
+			}
+		}
+		workAvailable_.notify_all();
+	}
+
+	void EveScheduler::FreeJob(Job *inJob) {
+		delete inJob;
+	}
+}
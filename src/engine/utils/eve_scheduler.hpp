@@ -0,0 +1,114 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystemWithBarrier.h>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace eve {
+	enum EveSchedulerLane {
+		LANE_PHYSICS,		// jolt jobs, always picked first by any worker
+		LANE_FRAME,			// phases of the current frame (EvePhaseGraph), picked before the chunk jobs the main thread doesn't wait on
+		LANE_BACKGROUND,	// chunk noising / meshing, capped so physics always has free workers
+		LANE_MAIN			// never picked by workers, run by the main thread in pumpMainThread()
+	};
+
+	/*
+	* Owns every worker thread of the engine.
+	* Jolt runs on top of it through the JobSystem interface (physics lane) and the terrain
+	* posts its chunk jobs in the background lane.
+	*
+	* Chunk jobs can't be preempted once started, so the physics reservation is permanent:
+	* at most (workerCount - physicsReservedWorkers) background jobs run at the same time,
+	* the remaining workers are only woken up for physics jobs.
+	*/
+	class EveScheduler : public JPH::JobSystemWithBarrier {
+		public:
+			EveScheduler(unsigned int workers = 0, unsigned int physicsReserved = 0);
+			~EveScheduler();
+
+			EveScheduler(const EveScheduler&) = delete;
+			EveScheduler &operator=(const EveScheduler&) = delete;
+
+			void post(std::function<void()> task, EveSchedulerLane lane = LANE_BACKGROUND);
+			// resumes a suspended coroutine on the lane, cancel() never drops it (that would leak the frame)
+			void postResume(std::coroutine_handle<> handle, EveSchedulerLane lane);
+
+			// resumes the coroutine on the lane from the first pumpMainThread() where ready() returns true (checked on the main thread)
+			void pollResume(std::function<bool()> ready, std::coroutine_handle<> handle, EveSchedulerLane lane);
+
+			// main thread only, once per frame: resolves the polls and runs the main lane
+			void pumpMainThread();
+
+			// drops every queued (not yet started) plain task of the lane, jolt jobs and coroutine resumes are kept
+			void cancel(EveSchedulerLane lane);
+			// blocks until the lane has no queued nor running task
+			void waitIdle(EveSchedulerLane lane);
+
+			void setPhysicsReservedWorkers(unsigned int count);
+
+			unsigned int getWorkerCount() const { return workerCount; }
+			unsigned int getPhysicsReservedWorkers() const { return physicsReservedWorkers; }
+			unsigned int getBackgroundConcurrency() const { return workerCount - physicsReservedWorkers; }
+
+			size_t getQueuedCount(EveSchedulerLane lane);
+			unsigned int getRunningCount(EveSchedulerLane lane) const { return lane == LANE_PHYSICS ? runningPhysics.load() : lane == LANE_FRAME ? runningFrame.load() : lane == LANE_BACKGROUND ? runningBackground.load() : 0; }
+
+			// JPH::JobSystem
+			virtual int GetMaxConcurrency() const override { return int(workerCount) + 1; } // + the thread calling PhysicsSystem::Update
+			virtual JobHandle CreateJob(const char *inName, JPH::ColorArg inColor, const JobFunction &inJobFunction, JPH::uint32 inNumDependencies = 0) override;
+
+		protected:
+			virtual void QueueJob(Job *inJob) override;
+			virtual void QueueJobs(Job **inJobs, JPH::uint inNumJobs) override;
+			virtual void FreeJob(Job *inJob) override;
+
+		private:
+			struct Task {
+				Job *job = nullptr;
+				std::function<void()> function;
+				std::coroutine_handle<> resume = nullptr;
+
+				bool isCancellable() const { return !job && !resume; }
+				void run();
+			};
+
+			struct Poll {
+				std::function<bool()> ready;
+				std::coroutine_handle<> handle;
+				EveSchedulerLane lane;
+			};
+
+			void workerLoop();
+			bool canRunBackground() const;
+
+			unsigned int workerCount;
+			unsigned int physicsReservedWorkers;
+
+			boost::thread_group workers_;
+			boost::mutex mutex_;
+			boost::condition_variable workAvailable_;
+			boost::condition_variable laneIdle_;
+
+			std::deque<Task> physicsQueue_;
+			std::deque<Task> frameQueue_;
+			std::deque<Task> backgroundQueue_;
+			std::deque<Task> mainQueue_;
+			std::vector<Poll> polls_;
+
+			std::atomic<unsigned int> runningPhysics{0};
+			std::atomic<unsigned int> runningFrame{0};
+			std::atomic<unsigned int> runningBackground{0};
+
+			bool stopping_ = false;
+	};
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "eve_scheduler.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <coroutine>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace eve {
+	/*
+	* Coroutine based async work on top of the EveScheduler.
+	*
+	* A Task<T> is lazy: it starts when it's co_awaited (the caller resumes once it's done)
+	* or when it's handed to spawn() (fire and forget).
+	* Where the coroutine runs is explicit, co_await resumeOn(scheduler, lane) moves it to a lane:
+	*
+	*	Task<> edit(...) {
+	*		if (!co_await chunk->reached(CHUNK_STAGE_NOISED))	// see Chunk::StageAwaiter
+	*			co_return;
+	*		co_await resumeOn(scheduler, LANE_MAIN);
+	*		...
+	*	}
+	*
+	* The other awaitables: fenceSignaled (gpu uploads, see EveModel::finishUpload) and readFileAsync
+	* (see EveModel::loadModelAsync).
+	*/
+	template <typename T = void>
+	class Task;
+
+	namespace detail {
+		struct FinalAwaiter {
+			bool await_ready() const noexcept { return false; }
+
+			template <typename Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+				// symmetric transfer back to whoever awaited us
+				if (handle.promise().continuation)
+					return handle.promise().continuation;
+				return std::noop_coroutine();
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		struct PromiseBase {
+			std::coroutine_handle<> continuation;
+			std::exception_ptr exception;
+
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			FinalAwaiter final_suspend() const noexcept { return {}; }
+			void unhandled_exception() { exception = std::current_exception(); }
+		};
+
+		template <typename T>
+		struct Promise : PromiseBase {
+			std::optional<T> value;
+
+			Task<T> get_return_object();
+			template <typename U>
+			void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+			T result() {
+				if (exception)
+					std::rethrow_exception(exception);
+				return std::move(*value);
+			}
+		};
+
+		template <>
+		struct Promise<void> : PromiseBase {
+			Task<void> get_return_object();
+			void return_void() {}
+
+			void result() {
+				if (exception)
+					std::rethrow_exception(exception);
+			}
+		};
+	}
+
+	template <typename T>
+	class Task {
+		public:
+			using promise_type = detail::Promise<T>;
+			using handle_type = std::coroutine_handle<promise_type>;
+
+			Task() = default;
+			explicit Task(handle_type h) : handle{h} {}
+			~Task() { if (handle) handle.destroy(); }
+
+			Task(const Task&) = delete;
+			Task &operator=(const Task&) = delete;
+			Task(Task &&other) noexcept : handle{std::exchange(other.handle, nullptr)} {}
+			Task &operator=(Task &&other) noexcept {
+				if (this != &other) {
+					if (handle) handle.destroy();
+					handle = std::exchange(other.handle, nullptr);
+				}
+				return *this;
+			}
+
+			bool isDone() const { return !handle || handle.done(); }
+
+			// co_await task: starts it and resumes the caller when it's finished
+			bool await_ready() const noexcept { return !handle || handle.done(); }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+				handle.promise().continuation = caller;
+				return handle;
+			}
+			T await_resume() { return handle.promise().result(); }
+
+		private:
+			handle_type handle = nullptr;
+	};
+
+	namespace detail {
+		template <typename T>
+		Task<T> Promise<T>::get_return_object() { return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)}; }
+
+		inline Task<void> Promise<void>::get_return_object() { return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)}; }
+
+		// eager coroutine that frees itself at the end, used to run a Task without anyone awaiting it
+		struct DetachedTask {
+			struct promise_type {
+				DetachedTask get_return_object() const noexcept { return {}; }
+				std::suspend_never initial_suspend() const noexcept { return {}; }
+				std::suspend_never final_suspend() const noexcept { return {}; }
+				void return_void() const noexcept {}
+				void unhandled_exception() const noexcept { std::terminate(); }
+			};
+		};
+	}
+
+	// fire and forget, the task runs on the calling thread until its first co_await
+	template <typename T>
+	void spawn(Task<T> task) {
+		[](Task<T> t) -> detail::DetachedTask { co_await t; }(std::move(task));
+	}
+
+	// co_await resumeOn(scheduler, lane): the rest of the coroutine runs on that lane
+	struct ScheduleAwaiter {
+		EveScheduler &scheduler;
+		EveSchedulerLane lane;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) const { scheduler.postResume(handle, lane); }
+		void await_resume() const noexcept {}
+	};
+
+	inline ScheduleAwaiter resumeOn(EveScheduler &scheduler, EveSchedulerLane lane = LANE_BACKGROUND) {
+		return ScheduleAwaiter{scheduler, lane};
+	}
+
+	// suspends until the predicate is true, it's checked once per frame by EveScheduler::pumpMainThread()
+	struct PollAwaiter {
+		EveScheduler &scheduler;
+		std::function<bool()> ready;
+		EveSchedulerLane lane;
+
+		bool await_ready() const { return ready(); }
+		void await_suspend(std::coroutine_handle<> handle) const { scheduler.pollResume(ready, handle, lane); }
+		void await_resume() const noexcept {}
+	};
+
+	inline PollAwaiter untilReady(EveScheduler &scheduler, std::function<bool()> ready, EveSchedulerLane lane = LANE_MAIN) {
+		return PollAwaiter{scheduler, std::move(ready), lane};
+	}
+
+	// gpu upload fence signaled, the coroutine resumes on the main thread where the staging buffers can be released
+	inline PollAwaiter fenceSignaled(EveScheduler &scheduler, VkDevice device, VkFence fence) {
+		return untilReady(scheduler, [device, fence] { return vkGetFenceStatus(device, fence) == VK_SUCCESS; }, LANE_MAIN);
+	}
+
+	// file read complete, the read happens on the background lane and the caller continues there
+	inline Task<std::vector<char>> readFileAsync(EveScheduler &scheduler, std::string filepath) {
+		co_await resumeOn(scheduler, LANE_BACKGROUND);
+
+		std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		std::vector<char> buffer(fileSize);
+		file.seekg(0);
+		file.read(buffer.data(), fileSize);
+		co_return buffer;
+	}
+}
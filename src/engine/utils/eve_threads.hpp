@@ -2,41 +2,36 @@
 
 #include "../game/eve_terrain.hpp"
 #include "eve_enums.hpp"
+#include "eve_scheduler.hpp"
 
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS
 #include <boost/chrono.hpp>
-#include <boost/asio.hpp>
-#include <boost/asio/io_service.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread/thread.hpp>
-#include <boost/thread/thread_pool.hpp>
-#include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
+#include <atomic>
+#include <functional>
 #include <iostream>
 
 namespace eve {
+	/*
+	* Chunk job front-end.
+	* It doesn't own any thread anymore, every job goes to the background lane of the EveScheduler
+	* so terrain work and jolt share the same core budget.
+	*
+	* The lane is shared (coroutine resumes, other systems), so the pool keeps track of its own jobs:
+	* destroy() turns the queued ones into no-ops and waits for every one of them to be gone.
+	*/
 	class EveThreadPool {
 		public:
-			std::size_t MAX_THREADS = 12;
-
 			void faketask(std::string msg){
 				boost::this_thread::sleep_for(boost::chrono::milliseconds(rand() % 3000 + 1000));
 				std::cout << msg << std::endl;
 			}
 
-			EveThreadPool(std::size_t threadCount) : MAX_THREADS{threadCount} {
-				/*
-				* This will start the io_service_ processing loop. All tasks
-				* assigned with io_service_->post() will start executing.
-				*/
-				io_service_ = boost::make_shared<boost::asio::io_service>();
-				work_ = boost::make_shared<boost::asio::io_service::work>(*io_service_);
-
-				std::cout << "created thread pool of size" << MAX_THREADS << std::endl;
-				for (std::size_t i = 0; i < MAX_THREADS; ++i){
-					threadpool_.create_thread(boost::bind(&boost::asio::io_service::run, io_service_));
-				}
-			}
+			EveThreadPool(EveScheduler &scheduler) : eveScheduler{scheduler} {}
 
 			~EveThreadPool() {
 				destroy();
@@ -44,31 +39,63 @@ namespace eve {
 
 			void pushChunkToRemeshingQueue(Chunk *chunk) {
 				if (meshingMode == MESHING_OCTANT)
-					io_service_->post(boost::bind(&Chunk::remesh, chunk, chunk->root));
+					post(boost::bind(&Chunk::remesh, chunk, chunk->root));
 				if (meshingMode == MESHING_CHUNK)
-					io_service_->post(boost::bind(&Chunk::remesh2, chunk, chunk));
+					post(boost::bind(&Chunk::remesh2, chunk, chunk));
+				if (meshingMode == MESHING_GREEDY)
+					post(boost::bind(&Chunk::remeshGreedy, chunk, chunk));
 			}
 
 			void pushChunkToNoisingQueue(Chunk *chunk) {
-				io_service_->post(boost::bind(&Chunk::noise, chunk, chunk->root));
+				post(boost::bind(&Chunk::noise, chunk, chunk->root));
+			}
+
+			void pushChunkToColliderQueue(Chunk *chunk) {
+				post(boost::bind(&Chunk::updateColliders, chunk));
+			}
+
+			void pushChunkToCapQueue(Chunk *chunk) {
+				post(boost::bind(&Chunk::updateCaps, chunk));
 			}
 
 			void runFakeTasks(std::size_t jobsize) {
 				std::cout << "adding " << std::to_string(jobsize) << " jobs to the job pool" << std::endl;
 				for (std::size_t i = 0; i < jobsize; ++i){
-					io_service_->post(boost::bind(&EveThreadPool::faketask, this, "fake task " + std::to_string(i) + " ended"));
+					post(boost::bind(&EveThreadPool::faketask, this, "fake task " + std::to_string(i) + " ended"));
 				}
 			}
 
+			// drops the queued chunk jobs and waits for the running ones, chunks can be freed afterward
 			void destroy() {
-				io_service_->stop();
-				threadpool_.join_all();
+				generation++;
+				boost::unique_lock<boost::mutex> lock(mutex_);
+				idle_.wait(lock, [this] { return outstanding == 0; });
 			}
 
 			EveTerrainMeshingMode meshingMode = MESHING_CHUNK;
 		private:
-			boost::shared_ptr<boost::asio::io_service> io_service_;
-			boost::shared_ptr<boost::asio::io_service::work> work_;
-			boost::thread_group threadpool_;
+			void post(std::function<void()> job) {
+				{
+					boost::lock_guard<boost::mutex> lock(mutex_);
+					outstanding++;
+				}
+
+				// jobs of an older generation were cancelled by destroy(), they only check out
+				eveScheduler.post([this, jobGeneration = generation.load(), job = std::move(job)] {
+					if (jobGeneration == generation)
+						job();
+
+					boost::lock_guard<boost::mutex> lock(mutex_);
+					if (--outstanding == 0)
+						idle_.notify_all();
+				});
+			}
+
+			EveScheduler &eveScheduler;
+
+			std::atomic<unsigned int> generation{0};
+			boost::mutex mutex_;
+			boost::condition_variable idle_;
+			size_t outstanding = 0;
 	};
-}
\ No newline at end of file
+}